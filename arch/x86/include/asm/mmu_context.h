@@ -30,6 +30,12 @@ static inline void enter_lazy_tlb(struct mm_struct *mm, struct task_struct *tsk)
 #endif
 }
 
+/*
+ * Both paths go through a locked operation on mm_cpumask(next), which
+ * is a full memory barrier: membarrier() relies on it between the
+ * rq->curr update and the return of the new task to user-space (see
+ * ARCH_HAS_MEMBARRIER_SWITCH_MB).
+ */
 static inline void switch_mm(struct mm_struct *prev, struct mm_struct *next,
 			     struct task_struct *tsk)
 {
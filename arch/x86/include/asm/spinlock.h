@@ -14,7 +14,8 @@
  * on the local processor, one does not.
  *
  * These are fair FIFO ticket locks, which are currently limited to 256
- * CPUs.
+ * CPUs, or with CONFIG_QUEUED_SPINLOCKS fair FIFO queued (MCS) locks,
+ * which keep each waiter spinning on its own per-CPU node.
  *
  * (the type definitions are in asm/spinlock_types.h)
  */
@@ -172,6 +173,68 @@ static inline int __ticket_spin_is_contended(arch_spinlock_t *lock)
 	return (((tmp >> TICKET_SHIFT) - tmp) & ((1 << TICKET_SHIFT) - 1)) > 1;
 }
 
+#ifdef CONFIG_QUEUED_SPINLOCKS
+
+#if !defined(CONFIG_X86_32) || \
+	!(defined(CONFIG_X86_OOSTORE) || defined(CONFIG_X86_PPRO_FENCE))
+/*
+ * Stores are not reordered with older loads or stores, so a plain byte
+ * store to the locked byte is enough to release the lock.
+ */
+#define queued_spin_unlock queued_spin_unlock
+static __always_inline void queued_spin_unlock(arch_spinlock_t *lock)
+{
+	barrier();
+	ACCESS_ONCE(*(u8 *)&lock->val) = 0;
+}
+#endif
+
+#include <asm-generic/qspinlock.h>
+
+static inline int arch_spin_is_locked(arch_spinlock_t *lock)
+{
+	return queued_spin_is_locked(lock);
+}
+
+static __always_inline int arch_spin_value_unlocked(arch_spinlock_t lock)
+{
+	return queued_spin_value_unlocked(lock);
+}
+
+static inline int arch_spin_is_contended(arch_spinlock_t *lock)
+{
+	return queued_spin_is_contended(lock);
+}
+#define arch_spin_is_contended	arch_spin_is_contended
+
+static __always_inline void arch_spin_lock(arch_spinlock_t *lock)
+{
+	queued_spin_lock(lock);
+}
+
+static __always_inline int arch_spin_trylock(arch_spinlock_t *lock)
+{
+	return queued_spin_trylock(lock);
+}
+
+static __always_inline void arch_spin_unlock(arch_spinlock_t *lock)
+{
+	queued_spin_unlock(lock);
+}
+
+static __always_inline void arch_spin_lock_flags(arch_spinlock_t *lock,
+						  unsigned long flags)
+{
+	arch_spin_lock(lock);
+}
+
+static inline void arch_spin_unlock_wait(arch_spinlock_t *lock)
+{
+	queued_spin_unlock_wait(lock);
+}
+
+#else	/* !CONFIG_QUEUED_SPINLOCKS */
+
 #ifndef CONFIG_PARAVIRT_SPINLOCKS
 
 static inline int arch_spin_is_locked(arch_spinlock_t *lock)
@@ -179,6 +242,11 @@ static inline int arch_spin_is_locked(arch_spinlock_t *lock)
 	return __ticket_spin_is_locked(lock);
 }
 
+static __always_inline int arch_spin_value_unlocked(arch_spinlock_t lock)
+{
+	return !__ticket_spin_is_locked(&lock);
+}
+
 static inline int arch_spin_is_contended(arch_spinlock_t *lock)
 {
 	return __ticket_spin_is_contended(lock);
@@ -214,6 +282,8 @@ static inline void arch_spin_unlock_wait(arch_spinlock_t *lock)
 		cpu_relax();
 }
 
+#endif	/* CONFIG_QUEUED_SPINLOCKS */
+
 /*
  * Read-write spinlocks, allowing multiple readers
  * but only one writer.
@@ -5,11 +5,20 @@
 # error "please don't include this file directly"
 #endif
 
+/*
+ * The same 32-bit word holds either a ticket lock or, with
+ * CONFIG_QUEUED_SPINLOCKS, a queued lock; see asm-generic/qspinlock_types.h.
+ * The ticket accessors stay usable either way so the two can be compared
+ * on one kernel.
+ */
 typedef struct arch_spinlock {
-	unsigned int slock;
+	union {
+		unsigned int slock;
+		atomic_t val;
+	};
 } arch_spinlock_t;
 
-#define __ARCH_SPIN_LOCK_UNLOCKED	{ 0 }
+#define __ARCH_SPIN_LOCK_UNLOCKED	{ { 0 } }
 
 typedef struct {
 	unsigned int lock;
@@ -352,10 +352,17 @@
 #define __NR_syncfs             344
 #define __NR_sendmmsg		345
 #define __NR_setns		346
+#define __NR_process_vm_readv	347
+#define __NR_process_vm_writev	348
+#define __NR_userfaultfd	349
+#define __NR_sched_setattr	350
+#define __NR_sched_getattr	351
+#define __NR_rseq		352
+#define __NR_membarrier		353
 
 #ifdef __KERNEL__
 
-#define NR_syscalls 347
+#define NR_syscalls 354
 
 #define __ARCH_WANT_IPC_PARSE_VERSION
 #define __ARCH_WANT_OLD_READDIR
@@ -681,6 +681,20 @@ __SYSCALL(__NR_syncfs, sys_syncfs)
 __SYSCALL(__NR_sendmmsg, sys_sendmmsg)
 #define __NR_setns				308
 __SYSCALL(__NR_setns, sys_setns)
+#define __NR_process_vm_readv			310
+__SYSCALL(__NR_process_vm_readv, sys_process_vm_readv)
+#define __NR_process_vm_writev			311
+__SYSCALL(__NR_process_vm_writev, sys_process_vm_writev)
+#define __NR_userfaultfd			312
+__SYSCALL(__NR_userfaultfd, sys_userfaultfd)
+#define __NR_sched_setattr			313
+__SYSCALL(__NR_sched_setattr, sys_sched_setattr)
+#define __NR_sched_getattr			314
+__SYSCALL(__NR_sched_getattr, sys_sched_getattr)
+#define __NR_rseq				315
+__SYSCALL(__NR_rseq, sys_rseq)
+#define __NR_membarrier				316
+__SYSCALL(__NR_membarrier, sys_membarrier)
 
 #ifndef __NO_STUBS
 #define __ARCH_WANT_OLD_READDIR
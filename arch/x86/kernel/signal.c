@@ -658,6 +658,12 @@ setup_rt_frame(int sig, struct k_sigaction *ka, siginfo_t *info,
 	int usig = signr_convert(sig);
 	int ret;
 
+	/*
+	 * Abort an interrupted rseq critical section before its
+	 * registers are saved in the signal frame.
+	 */
+	rseq_signal_deliver(sig, regs);
+
 	/* Set up the stack frame */
 	if (is_ia32) {
 		if (ka->sa.sa_flags & SA_SIGINFO)
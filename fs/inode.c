@@ -281,6 +281,13 @@ void address_space_init_once(struct address_space *mapping)
 {
 	memset(mapping, 0, sizeof(*mapping));
 	INIT_RADIX_TREE(&mapping->page_tree, GFP_ATOMIC);
+	/*
+	 * Shadow nodes are allocated by reclaim, which runs PF_MEMALLOC:
+	 * they are not worth dipping into the emergency reserves for.
+	 */
+	INIT_RADIX_TREE(&mapping->shadow_tree,
+			GFP_NOWAIT | __GFP_NOWARN | __GFP_NOMEMALLOC);
+	INIT_LIST_HEAD(&mapping->shadow_list);
 	spin_lock_init(&mapping->tree_lock);
 	mutex_init(&mapping->i_mmap_mutex);
 	INIT_LIST_HEAD(&mapping->private_list);
@@ -431,6 +438,8 @@ void end_writeback(struct inode *inode)
 	spin_lock_irq(&inode->i_data.tree_lock);
 	BUG_ON(inode->i_data.nrpages);
 	spin_unlock_irq(&inode->i_data.tree_lock);
+	/* Not every ->evict_inode truncates a mapping without pages */
+	workingset_forget(&inode->i_data, 0, ULONG_MAX);
 	BUG_ON(!list_empty(&inode->i_data.private_list));
 	BUG_ON(!(inode->i_state & I_FREEING));
 	BUG_ON(inode->i_state & I_CLEAR);
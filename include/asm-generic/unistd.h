@@ -685,9 +685,25 @@ __SYSCALL(__NR_syncfs, sys_syncfs)
 __SYSCALL(__NR_setns, sys_setns)
 #define __NR_sendmmsg 269
 __SC_COMP(__NR_sendmmsg, sys_sendmmsg, compat_sys_sendmmsg)
+#define __NR_process_vm_readv 270
+__SC_COMP(__NR_process_vm_readv, sys_process_vm_readv, \
+          compat_sys_process_vm_readv)
+#define __NR_process_vm_writev 271
+__SC_COMP(__NR_process_vm_writev, sys_process_vm_writev, \
+          compat_sys_process_vm_writev)
+#define __NR_userfaultfd 272
+__SYSCALL(__NR_userfaultfd, sys_userfaultfd)
+#define __NR_sched_setattr 273
+__SYSCALL(__NR_sched_setattr, sys_sched_setattr)
+#define __NR_sched_getattr 274
+__SYSCALL(__NR_sched_getattr, sys_sched_getattr)
+#define __NR_rseq 275
+__SYSCALL(__NR_rseq, sys_rseq)
+#define __NR_membarrier 276
+__SYSCALL(__NR_membarrier, sys_membarrier)
 
 #undef __NR_syscalls
-#define __NR_syscalls 270
+#define __NR_syscalls 277
 
 /*
  * All syscalls below here should go away really,
@@ -0,0 +1,47 @@
+#ifndef _LINUX_MEMBARRIER_H
+#define _LINUX_MEMBARRIER_H
+
+/**
+ * enum membarrier_cmd - membarrier system call command
+ * @MEMBARRIER_CMD_QUERY:   Query the set of supported commands. It returns
+ *                          a bitmask of valid commands.
+ * @MEMBARRIER_CMD_SHARED:  Execution of a memory barrier on all running
+ *                          threads of all processes. Upon return from
+ *                          system call, the caller thread is ensured that
+ *                          all running threads have passed through a state
+ *                          where all memory accesses to user-space
+ *                          addresses match program order between entry to
+ *                          and return from the system call (non-running
+ *                          threads are de facto in such a state). This
+ *                          covers threads from all processes running on
+ *                          the system. This command returns 0.
+ * @MEMBARRIER_CMD_PRIVATE_EXPEDITED:
+ *                          Execution of a memory barrier on each running
+ *                          thread belonging to the same process as the
+ *                          current thread. Upon return from system call,
+ *                          the caller thread is ensured that all its
+ *                          running threads siblings have passed through
+ *                          a state where all memory accesses to
+ *                          user-space addresses match program order
+ *                          between entry to and return from the system
+ *                          call (non-running threads are de facto in such
+ *                          a state). This only covers threads from the
+ *                          same process as the caller thread. It is
+ *                          implemented with IPIs to the CPUs running those
+ *                          threads, so it is faster than
+ *                          MEMBARRIER_CMD_SHARED and never blocks.
+ *                          This command returns 0.
+ *
+ * Command to be passed to the membarrier system call. The commands need to
+ * be a single bit each, except for MEMBARRIER_CMD_QUERY which is assigned to
+ * the value 0.
+ */
+enum membarrier_cmd {
+	MEMBARRIER_CMD_QUERY			= 0,
+	MEMBARRIER_CMD_SHARED			= (1 << 0),
+	/* reserved MEMBARRIER_CMD_SHARED_EXPEDITED (1 << 1) */
+	/* reserved MEMBARRIER_CMD_PRIVATE (1 << 2) */
+	MEMBARRIER_CMD_PRIVATE_EXPEDITED	= (1 << 3),
+};
+
+#endif /* _LINUX_MEMBARRIER_H */
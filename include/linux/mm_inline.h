@@ -21,6 +21,136 @@ static inline int page_is_file_cache(struct page *page)
 	return !PageSwapBacked(page);
 }
 
+#ifdef CONFIG_LRU_GEN
+
+extern bool lru_gen_enabled_flag;
+
+static inline bool lru_gen_enabled(void)
+{
+	return lru_gen_enabled_flag;
+}
+
+static inline int lru_gen_from_seq(unsigned long seq)
+{
+	return seq % MAX_NR_GENS;
+}
+
+/* Returns the generation of @page, or -1 if it is not on a generation list */
+static inline int page_lru_gen(struct page *page)
+{
+	return (int)((ACCESS_ONCE(page->flags) & LRU_GEN_MASK) >>
+		     LRU_GEN_PGOFF) - 1;
+}
+
+/*
+ * Sets the generation of @page and returns the old one. Page table walks
+ * update the generation without zone->lru_lock, and the other page flags
+ * may be changed concurrently too, hence the cmpxchg.
+ */
+static inline int page_set_lru_gen(struct page *page, int gen)
+{
+	unsigned long old_flags, new_flags;
+
+	do {
+		old_flags = ACCESS_ONCE(page->flags);
+		new_flags = (old_flags & ~LRU_GEN_MASK) |
+			    ((gen + 1UL) << LRU_GEN_PGOFF);
+	} while (cmpxchg(&page->flags, old_flags, new_flags) != old_flags);
+
+	return (int)((old_flags & LRU_GEN_MASK) >> LRU_GEN_PGOFF) - 1;
+}
+
+static inline void lru_gen_update_size(struct zone *zone, struct page *page,
+				       int gen, long delta)
+{
+	if (gen >= 0)
+		zone->lrugen.nr_pages[gen][page_is_file_cache(page)] += delta;
+}
+
+/* Takes @page off its generation, if any. Needs zone->lru_lock. */
+static inline void lru_gen_del_page(struct zone *zone, struct page *page)
+{
+	int gen;
+
+	if (!(ACCESS_ONCE(page->flags) & LRU_GEN_MASK))
+		return;
+
+	gen = page_set_lru_gen(page, -1);
+	lru_gen_update_size(zone, page, gen, -hpage_nr_pages(page));
+}
+
+/*
+ * Puts @page on a generation and returns the list it belongs on: active
+ * pages join the youngest generation, inactive ones the oldest of their
+ * type. Needs zone->lru_lock.
+ */
+static inline struct list_head *lru_gen_page_list(struct zone *zone,
+						  struct page *page)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	int type = page_is_file_cache(page);
+	unsigned long seq;
+	int gen;
+
+	seq = PageActive(page) ? lrugen->max_seq : lrugen->min_seq[type];
+	gen = lru_gen_from_seq(seq);
+
+	lru_gen_del_page(zone, page);
+	page_set_lru_gen(page, gen);
+	lru_gen_update_size(zone, page, gen, hpage_nr_pages(page));
+
+	return &lrugen->lists[gen][type];
+}
+
+/**
+ * lru_list_head - which list should a page be put on?
+ * @zone: the zone of the page, whose lru_lock is held
+ * @page: the page to put on an LRU list
+ * @l: the LRU list the page is accounted to
+ *
+ * Returns the active or inactive list @l, or the generation list of @page
+ * if the zone uses the multi-generational LRU.
+ */
+static inline struct list_head *lru_list_head(struct zone *zone,
+					      struct page *page,
+					      enum lru_list l)
+{
+	if (zone->lrugen.enabled && l != LRU_UNEVICTABLE)
+		return lru_gen_page_list(zone, page);
+
+	return &zone->lru[l].list;
+}
+
+#else /* !CONFIG_LRU_GEN */
+
+static inline bool lru_gen_enabled(void)
+{
+	return false;
+}
+
+static inline int page_lru_gen(struct page *page)
+{
+	return -1;
+}
+
+static inline void lru_gen_update_size(struct zone *zone, struct page *page,
+				       int gen, long delta)
+{
+}
+
+static inline void lru_gen_del_page(struct zone *zone, struct page *page)
+{
+}
+
+static inline struct list_head *lru_list_head(struct zone *zone,
+					      struct page *page,
+					      enum lru_list l)
+{
+	return &zone->lru[l].list;
+}
+
+#endif /* CONFIG_LRU_GEN */
+
 static inline void
 __add_page_to_lru_list(struct zone *zone, struct page *page, enum lru_list l,
 		       struct list_head *head)
@@ -33,13 +163,14 @@ __add_page_to_lru_list(struct zone *zone, struct page *page, enum lru_list l,
 static inline void
 add_page_to_lru_list(struct zone *zone, struct page *page, enum lru_list l)
 {
-	__add_page_to_lru_list(zone, page, l, &zone->lru[l].list);
+	__add_page_to_lru_list(zone, page, l, lru_list_head(zone, page, l));
 }
 
 static inline void
 del_page_from_lru_list(struct zone *zone, struct page *page, enum lru_list l)
 {
 	list_del(&page->lru);
+	lru_gen_del_page(zone, page);
 	__mod_zone_page_state(zone, NR_LRU_BASE + l, -hpage_nr_pages(page));
 	mem_cgroup_del_lru_list(page, l);
 }
@@ -65,6 +196,7 @@ del_page_from_lru(struct zone *zone, struct page *page)
 	enum lru_list l;
 
 	list_del(&page->lru);
+	lru_gen_del_page(zone, page);
 	if (PageUnevictable(page)) {
 		__ClearPageUnevictable(page);
 		l = LRU_UNEVICTABLE;
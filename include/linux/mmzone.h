@@ -106,6 +106,8 @@ enum zone_stat_item {
 	NR_SHMEM,		/* shmem pages (included tmpfs/GEM pages) */
 	NR_DIRTIED,		/* page dirtyings since bootup */
 	NR_WRITTEN,		/* page writings since bootup */
+	WORKINGSET_REFAULT,	/* evicted page cache refaulted */
+	WORKINGSET_ACTIVATE,	/* refaulted page was activated */
 #ifdef CONFIG_NUMA
 	NUMA_HIT,		/* allocated in intended node */
 	NUMA_MISS,		/* allocated in non intended node */
@@ -169,13 +171,19 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * The pcp lists hold pages of every order up to PAGE_ALLOC_COSTLY_ORDER,
+ * one list per migrate type and order.
+ */
+#define NR_PCP_LISTS (MIGRATE_PCPTYPES * (PAGE_ALLOC_COSTLY_ORDER + 1))
+
 struct per_cpu_pages {
-	int count;		/* number of pages in the list */
+	int count;		/* number of base pages in the lists */
 	int high;		/* high watermark, emptying needed */
 	int batch;		/* chunk size for buddy add/remove */
 
-	/* Lists of pages, one per migrate type stored on the pcp-lists */
-	struct list_head lists[MIGRATE_PCPTYPES];
+	/* Lists of pages, one per migrate type and order */
+	struct list_head lists[NR_PCP_LISTS];
 };
 
 struct per_cpu_pageset {
@@ -275,6 +283,37 @@ struct zone_reclaim_stat {
 	unsigned long		recent_scanned[2];
 };
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * The multi-generational LRU keeps the evictable pages of a zone on a
+ * small number of generation lists instead of the active and inactive
+ * lists. max_seq is the youngest generation, shared by anon and file;
+ * min_seq[] the oldest one of each type. The two youngest generations
+ * are protected from eviction, and generations are aged by scanning
+ * page tables for accessed bits rather than by walking the rmap of
+ * each page.
+ *
+ * Everything is protected by zone->lru_lock.
+ */
+#define MIN_NR_GENS		2U
+#define MAX_NR_GENS		4U
+
+struct lru_gen_struct {
+	/* the youngest generation */
+	unsigned long max_seq;
+	/* the oldest generation of anon [0] and file [1] pages */
+	unsigned long min_seq[2];
+	/* the birth time of each generation in jiffies */
+	unsigned long timestamps[MAX_NR_GENS];
+	/* the generation lists, indexed by seq % MAX_NR_GENS and type */
+	struct list_head lists[MAX_NR_GENS][2];
+	/* the number of pages in each generation, may lag behind briefly */
+	long nr_pages[MAX_NR_GENS][2];
+	/* whether the evictable pages of the zone are on the lists above */
+	bool enabled;
+};
+#endif
+
 struct zone {
 	/* Fields commonly accessed by the page allocator */
 
@@ -343,6 +382,9 @@ struct zone {
 	struct zone_lru {
 		struct list_head list;
 	} lru[NR_LRU_LISTS];
+#ifdef CONFIG_LRU_GEN
+	struct lru_gen_struct	lrugen;
+#endif
 
 	struct zone_reclaim_stat reclaim_stat;
 
@@ -358,6 +400,11 @@ struct zone {
 	 */
 	unsigned int inactive_ratio;
 
+	/* Evictions & activations on the inactive file list */
+	atomic_long_t		inactive_age;
+
+	/* WORKINGSET_ACTIVATE as of the end of the last reclaim cycle */
+	unsigned long		refaults;
 
 	ZONE_PADDING(_pad2_)
 	/* Rarely used or read-mostly fields */
@@ -636,6 +683,16 @@ typedef struct pglist_data {
 	struct task_struct *kswapd;
 	int kswapd_max_order;
 	enum zone_type classzone_idx;
+#ifdef CONFIG_COMPACTION
+	int kcompactd_max_order;
+	enum zone_type kcompactd_classzone_idx;
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	bool proactive_compact_trigger;
+#endif
+#ifdef CONFIG_LRU_GEN
+	unsigned long lru_gen_aging;	/* bit 0: page table walk running */
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
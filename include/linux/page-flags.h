@@ -106,6 +106,10 @@ enum pageflags {
 #endif
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	PG_compound_lock,
+#endif
+#ifdef CONFIG_IDLE_PAGE_TRACKING
+	PG_young,		/* Accessed since the page was last marked idle */
+	PG_idle,		/* Not accessed since marked idle via sysfs */
 #endif
 	__NR_PAGEFLAGS,
 
@@ -0,0 +1,78 @@
+#ifndef _LINUX_MM_PAGE_IDLE_H
+#define _LINUX_MM_PAGE_IDLE_H
+
+#include <linux/bitops.h>
+#include <linux/page-flags.h>
+
+/*
+ * Idle page tracking: see Documentation/vm/idle_page_tracking.txt.
+ *
+ * PG_idle is set by userspace through /sys/kernel/mm/page_idle/bitmap and
+ * cleared whenever the page is found to be accessed.  PG_young preserves
+ * an accessed bit that idle tracking had to clear from the page tables,
+ * so that page reclaim does not lose the reference.
+ */
+#ifdef CONFIG_IDLE_PAGE_TRACKING
+
+static inline bool page_is_young(struct page *page)
+{
+	return test_bit(PG_young, &page->flags);
+}
+
+static inline void set_page_young(struct page *page)
+{
+	set_bit(PG_young, &page->flags);
+}
+
+static inline bool test_and_clear_page_young(struct page *page)
+{
+	return test_and_clear_bit(PG_young, &page->flags);
+}
+
+static inline bool page_is_idle(struct page *page)
+{
+	return test_bit(PG_idle, &page->flags);
+}
+
+static inline void set_page_idle(struct page *page)
+{
+	set_bit(PG_idle, &page->flags);
+}
+
+static inline void clear_page_idle(struct page *page)
+{
+	clear_bit(PG_idle, &page->flags);
+}
+
+#else /* !CONFIG_IDLE_PAGE_TRACKING */
+
+static inline bool page_is_young(struct page *page)
+{
+	return false;
+}
+
+static inline void set_page_young(struct page *page)
+{
+}
+
+static inline bool test_and_clear_page_young(struct page *page)
+{
+	return false;
+}
+
+static inline bool page_is_idle(struct page *page)
+{
+	return false;
+}
+
+static inline void set_page_idle(struct page *page)
+{
+}
+
+static inline void clear_page_idle(struct page *page)
+{
+}
+
+#endif /* CONFIG_IDLE_PAGE_TRACKING */
+
+#endif /* _LINUX_MM_PAGE_IDLE_H */
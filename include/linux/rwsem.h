@@ -18,6 +18,7 @@
 #include <asm/atomic.h>
 
 struct rw_semaphore;
+struct mcs_spinlock;
 
 #ifdef CONFIG_RWSEM_GENERIC_SPINLOCK
 #include <linux/rwsem-spinlock.h> /* use a generic implementation */
@@ -27,6 +28,14 @@ struct rw_semaphore {
 	long			count;
 	spinlock_t		wait_lock;
 	struct list_head	wait_list;
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+	/*
+	 * Write owner, used by down_write() spinners to tell whether the
+	 * owner is running; NULL when unowned or read-owned.
+	 */
+	struct task_struct	*owner;
+	struct mcs_spinlock	*osq;	/* spinner MCS queue */
+#endif
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map	dep_map;
 #endif
@@ -56,9 +65,16 @@ static inline int rwsem_is_locked(struct rw_semaphore *sem)
 # define __RWSEM_DEP_MAP_INIT(lockname)
 #endif
 
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+# define __RWSEM_OPT_INIT(lockname) , .owner = NULL, .osq = NULL
+#else
+# define __RWSEM_OPT_INIT(lockname)
+#endif
+
 #define __RWSEM_INITIALIZER(name) \
 	{ RWSEM_UNLOCKED_VALUE, __SPIN_LOCK_UNLOCKED(name.wait_lock),	\
-	  LIST_HEAD_INIT((name).wait_list) __RWSEM_DEP_MAP_INIT(name) }
+	  LIST_HEAD_INIT((name).wait_list) __RWSEM_OPT_INIT(name)	\
+	  __RWSEM_DEP_MAP_INIT(name) }
 
 #define DECLARE_RWSEM(name) \
 	struct rw_semaphore name = __RWSEM_INITIALIZER(name)
@@ -92,6 +92,7 @@
  */
 
 struct net_device;
+struct napi_struct;
 struct scatterlist;
 struct pipe_inode_info;
 
@@ -490,6 +491,9 @@ static inline struct rtable *skb_rtable(const struct sk_buff *skb)
 extern void kfree_skb(struct sk_buff *skb);
 extern void consume_skb(struct sk_buff *skb);
 extern void	       __kfree_skb(struct sk_buff *skb);
+extern void	       __kfree_skb_defer(struct sk_buff *skb);
+extern void	       napi_consume_skb(struct sk_buff *skb, int budget);
+extern void	       napi_skb_cache_drain(unsigned int cpu);
 extern struct sk_buff *__alloc_skb(unsigned int size,
 				   gfp_t priority, int fclone, int node);
 static inline struct sk_buff *alloc_skb(unsigned int size,
@@ -1572,6 +1576,23 @@ static inline struct sk_buff *netdev_alloc_skb_ip_align(struct net_device *dev,
 	return skb;
 }
 
+extern struct sk_buff *__napi_alloc_skb(struct napi_struct *napi,
+		unsigned int length, gfp_t gfp_mask);
+
+/**
+ *	napi_alloc_skb - allocate an skbuff from a NAPI poll routine
+ *	@napi: napi instance this buffer was allocated for
+ *	@length: length to allocate
+ *
+ *	Like netdev_alloc_skb_ip_align() for napi->dev, but recycles the
+ *	heads of the skbs freed in NAPI context on this cpu.
+ */
+static inline struct sk_buff *napi_alloc_skb(struct napi_struct *napi,
+		unsigned int length)
+{
+	return __napi_alloc_skb(napi, length, GFP_ATOMIC);
+}
+
 /**
  *	__netdev_alloc_page - allocate a page for ps-rx on a specific device
  *	@dev: network device to receive on
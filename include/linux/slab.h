@@ -106,6 +106,19 @@ int kmem_cache_shrink(struct kmem_cache *);
 void kmem_cache_free(struct kmem_cache *, void *);
 unsigned int kmem_cache_size(struct kmem_cache *);
 
+/*
+ * Bulk allocation and freeing of objects of a cache. These fill or drain
+ * an array of objects at once, in a way that each allocator can make
+ * cheaper than repeated calls: SLUB disables interrupts only once and
+ * works on the lockless freelist of the cpu slab.
+ *
+ * kmem_cache_alloc_bulk() returns the number of objects allocated, which
+ * is either all of them or zero. Interrupts must be enabled when calling
+ * these functions.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *, size_t, void **);
+int kmem_cache_alloc_bulk(struct kmem_cache *, gfp_t, size_t, void **);
+
 /*
  * Please use this macro to create slab caches. Simply specify the
  * name of the structure and maybe some flags that are listed above.
@@ -566,6 +566,7 @@ static inline void set_notify_resume(struct task_struct *task)
  */
 static inline void tracehook_notify_resume(struct pt_regs *regs)
 {
+	rseq_handle_notify_resume(regs);
 }
 #endif	/* TIF_NOTIFY_RESUME */
 
@@ -0,0 +1,385 @@
+/*
+ * Module-based torture test facility for spinlocks
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * A set of writer kthreads repeatedly takes a single lock, holds it for
+ * a short random time and releases it.  Each thread counts its own
+ * acquisitions; the totals give the throughput of the lock under
+ * contention and the spread between threads shows how fair it is.  A
+ * flag set inside the critical section catches two threads holding the
+ * lock at once.
+ *
+ * Load with e.g. "modprobe locktorture torture_type=queued_spin" and
+ * compare against "torture_type=ticket_spin" on the same machine.
+ */
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/kthread.h>
+#include <linux/err.h>
+#include <linux/spinlock.h>
+#include <linux/sched.h>
+#include <linux/moduleparam.h>
+#include <linux/delay.h>
+#include <linux/slab.h>
+#include <linux/random.h>
+#include <linux/jiffies.h>
+#include <asm/atomic.h>
+
+MODULE_LICENSE("GPL");
+
+static int nwriters_stress = -1; /* # writer threads, defaults to 2*ncpus */
+static int stat_interval;	/* Interval between stats, in seconds. */
+				/*  Defaults to "only at end of test". */
+static int shortdelay_us = 2;	/* Short hold time, in microseconds. */
+static int longdelay_us = 1000;	/* Occasional long hold time, in us. */
+static int verbose;		/* Print more debug info. */
+static char *torture_type = "spin_lock"; /* What lock to torture. */
+
+module_param(nwriters_stress, int, 0444);
+MODULE_PARM_DESC(nwriters_stress, "Number of write-locking stress-test threads");
+module_param(stat_interval, int, 0444);
+MODULE_PARM_DESC(stat_interval, "Number of seconds between stats printk()s");
+module_param(shortdelay_us, int, 0444);
+MODULE_PARM_DESC(shortdelay_us, "Short hold time in critical section (us)");
+module_param(longdelay_us, int, 0444);
+MODULE_PARM_DESC(longdelay_us, "Occasional long hold time in critical section (us)");
+module_param(verbose, bool, 0444);
+MODULE_PARM_DESC(verbose, "Enable verbose debugging printk()s");
+module_param(torture_type, charp, 0444);
+MODULE_PARM_DESC(torture_type,
+		 "Type of lock to torture (spin_lock, ticket_spin, queued_spin)");
+
+#define TORTURE_FLAG "-torture:"
+#define VERBOSE_PRINTK_STRING(s) \
+	do { if (verbose) printk(KERN_ALERT "%s" TORTURE_FLAG s "\n", torture_type); } while (0)
+
+struct lock_writer_stress_stats {
+	long n_write_lock_fail;
+	long n_write_lock_acquired;
+};
+
+static int nrealwriters_stress;
+static struct task_struct **writer_tasks;
+static struct task_struct *stats_task;
+static struct lock_writer_stress_stats *lwsa;
+static unsigned long start_jiffies;
+
+static int lock_is_write_held;
+static atomic_t n_lock_torture_errors;
+
+struct lock_torture_ops {
+	void (*init)(void);
+	void (*writelock)(void);
+	void (*writeunlock)(void);
+	const char *name;
+};
+
+static struct lock_torture_ops *cur_ops;
+
+/*
+ * Hold the lock for shortdelay_us now and then, and for longdelay_us
+ * very rarely, so that waiters pile up behind the holder.
+ */
+static void torture_lock_delay(void)
+{
+	u32 r = random32();
+
+	if (!(r % (nrealwriters_stress * 2000)))
+		mdelay(longdelay_us / 1000);
+	else if (!(r % (nrealwriters_stress * 2 * shortdelay_us)))
+		udelay(shortdelay_us);
+}
+
+/*
+ * Plain spin_lock(), i.e. whatever implementation this kernel uses.
+ */
+static DEFINE_SPINLOCK(torture_spinlock);
+
+static void torture_spin_lock_write_lock(void) __acquires(torture_spinlock)
+{
+	spin_lock(&torture_spinlock);
+}
+
+static void torture_spin_lock_write_unlock(void) __releases(torture_spinlock)
+{
+	spin_unlock(&torture_spinlock);
+}
+
+static struct lock_torture_ops spin_lock_ops = {
+	.writelock	= torture_spin_lock_write_lock,
+	.writeunlock	= torture_spin_lock_write_unlock,
+	.name		= "spin_lock"
+};
+
+#if defined(CONFIG_X86) || defined(CONFIG_QUEUED_SPINLOCKS)
+/*
+ * The raw arch implementations, bypassing lockdep and the spinlock
+ * debugging code so that only the lock algorithm itself is measured.
+ */
+static arch_spinlock_t torture_arch_lock = __ARCH_SPIN_LOCK_UNLOCKED;
+#endif
+
+#ifdef CONFIG_X86
+static void torture_ticket_spin_write_lock(void)
+{
+	preempt_disable();
+	__ticket_spin_lock(&torture_arch_lock);
+}
+
+static void torture_ticket_spin_write_unlock(void)
+{
+	__ticket_spin_unlock(&torture_arch_lock);
+	preempt_enable();
+}
+
+static struct lock_torture_ops ticket_spin_ops = {
+	.writelock	= torture_ticket_spin_write_lock,
+	.writeunlock	= torture_ticket_spin_write_unlock,
+	.name		= "ticket_spin"
+};
+#endif
+
+#ifdef CONFIG_QUEUED_SPINLOCKS
+static void torture_queued_spin_write_lock(void)
+{
+	preempt_disable();
+	queued_spin_lock(&torture_arch_lock);
+}
+
+static void torture_queued_spin_write_unlock(void)
+{
+	queued_spin_unlock(&torture_arch_lock);
+	preempt_enable();
+}
+
+static struct lock_torture_ops queued_spin_ops = {
+	.writelock	= torture_queued_spin_write_lock,
+	.writeunlock	= torture_queued_spin_write_unlock,
+	.name		= "queued_spin"
+};
+#endif
+
+/*
+ * Lock torture writer kthread.  Repeatedly acquires and releases
+ * the lock, checking for duplicate acquisitions.
+ */
+static int lock_torture_writer(void *arg)
+{
+	struct lock_writer_stress_stats *lwsp = arg;
+
+	VERBOSE_PRINTK_STRING("lock_torture_writer task started");
+	set_user_nice(current, 19);
+
+	do {
+		cur_ops->writelock();
+		if (WARN_ON_ONCE(lock_is_write_held)) {
+			lwsp->n_write_lock_fail++;
+			atomic_inc(&n_lock_torture_errors);
+		}
+		lock_is_write_held = 1;
+		torture_lock_delay();
+		lock_is_write_held = 0;
+		cur_ops->writeunlock();
+		lwsp->n_write_lock_acquired++;
+		cond_resched();
+	} while (!kthread_should_stop());
+	VERBOSE_PRINTK_STRING("lock_torture_writer task stopping");
+	return 0;
+}
+
+/*
+ * Print torture statistics: total acquisitions, acquisitions per second
+ * and the fewest/most any single thread got.
+ */
+static void lock_torture_stats_print(void)
+{
+	long nmin = nrealwriters_stress ? LONG_MAX : 0, nmax = 0;
+	long sum = 0, fail = 0;
+	unsigned long secs;
+	int i;
+
+	for (i = 0; i < nrealwriters_stress; i++) {
+		long n = lwsa[i].n_write_lock_acquired;
+
+		sum += n;
+		fail += lwsa[i].n_write_lock_fail;
+		nmin = min(nmin, n);
+		nmax = max(nmax, n);
+	}
+	secs = (jiffies - start_jiffies) / HZ ? : 1;
+
+	printk(KERN_ALERT "%s%s Writes: Total: %ld (%lu/s) "
+	       "Max/Min: %ld/%ld %s Fail: %ld %s\n",
+	       torture_type, TORTURE_FLAG, sum, sum / secs, nmax, nmin,
+	       nmax > nmin * 2 ? "???" : "", fail, fail ? "!!!" : "");
+}
+
+/*
+ * Periodically prints torture statistics, if periodic statistics printing
+ * was specified via the stat_interval module parameter.
+ */
+static int lock_torture_stats(void *arg)
+{
+	VERBOSE_PRINTK_STRING("lock_torture_stats task started");
+	do {
+		schedule_timeout_interruptible(stat_interval * HZ);
+		lock_torture_stats_print();
+	} while (!kthread_should_stop());
+	VERBOSE_PRINTK_STRING("lock_torture_stats task stopping");
+	return 0;
+}
+
+static inline void
+lock_torture_print_module_parms(struct lock_torture_ops *cur_ops,
+				const char *tag)
+{
+	printk(KERN_ALERT "%s" TORTURE_FLAG
+	       "--- %s: nwriters_stress=%d stat_interval=%d verbose=%d "
+	       "shortdelay_us=%d longdelay_us=%d\n",
+	       torture_type, tag, nrealwriters_stress, stat_interval, verbose,
+	       shortdelay_us, longdelay_us);
+}
+
+static void lock_torture_cleanup(void)
+{
+	int i;
+
+	if (writer_tasks) {
+		for (i = 0; i < nrealwriters_stress; i++) {
+			if (writer_tasks[i]) {
+				VERBOSE_PRINTK_STRING(
+					"Stopping lock_torture_writer task");
+				kthread_stop(writer_tasks[i]);
+			}
+			writer_tasks[i] = NULL;
+		}
+		kfree(writer_tasks);
+		writer_tasks = NULL;
+	}
+
+	if (stats_task) {
+		VERBOSE_PRINTK_STRING("Stopping lock_torture_stats task");
+		kthread_stop(stats_task);
+	}
+	stats_task = NULL;
+
+	if (lwsa) {
+		lock_torture_stats_print();  /* -After- the stats thread is stopped! */
+		kfree(lwsa);
+		lwsa = NULL;
+	}
+
+	if (atomic_read(&n_lock_torture_errors))
+		lock_torture_print_module_parms(cur_ops,
+						"End of test: FAILURE");
+	else
+		lock_torture_print_module_parms(cur_ops,
+						"End of test: SUCCESS");
+}
+
+static int __init lock_torture_init(void)
+{
+	int i;
+	int firsterr = 0;
+	static struct lock_torture_ops *torture_ops[] = {
+		&spin_lock_ops,
+#ifdef CONFIG_X86
+		&ticket_spin_ops,
+#endif
+#ifdef CONFIG_QUEUED_SPINLOCKS
+		&queued_spin_ops,
+#endif
+	};
+
+	/* Process args and tell the world that the torturer is on the job. */
+	for (i = 0; i < ARRAY_SIZE(torture_ops); i++) {
+		cur_ops = torture_ops[i];
+		if (strcmp(torture_type, cur_ops->name) == 0)
+			break;
+	}
+	if (i == ARRAY_SIZE(torture_ops)) {
+		printk(KERN_ALERT "lock-torture: invalid torture type: \"%s\"\n",
+		       torture_type);
+		printk(KERN_ALERT "lock-torture types:");
+		for (i = 0; i < ARRAY_SIZE(torture_ops); i++)
+			printk(KERN_ALERT " %s", torture_ops[i]->name);
+		printk(KERN_ALERT "\n");
+		return -EINVAL;
+	}
+	if (shortdelay_us <= 0 || longdelay_us < 1000) {
+		printk(KERN_ALERT "lock-torture: shortdelay_us must be > 0 "
+				  "and longdelay_us >= 1000\n");
+		return -EINVAL;
+	}
+	if (cur_ops->init)
+		cur_ops->init(); /* no "goto unwind" prior to this point!!! */
+
+	if (nwriters_stress >= 0)
+		nrealwriters_stress = nwriters_stress;
+	else
+		nrealwriters_stress = 2 * num_online_cpus();
+	lock_torture_print_module_parms(cur_ops, "Start of test");
+
+	/* Initialize the statistics so that each run gets its own numbers. */
+
+	lock_is_write_held = 0;
+	atomic_set(&n_lock_torture_errors, 0);
+	lwsa = kzalloc(sizeof(*lwsa) * nrealwriters_stress, GFP_KERNEL);
+	if (lwsa == NULL) {
+		VERBOSE_PRINTK_STRING("lwsa: Out of memory");
+		firsterr = -ENOMEM;
+		goto unwind;
+	}
+	start_jiffies = jiffies;
+
+	/* Start up the kthreads. */
+
+	writer_tasks = kzalloc(nrealwriters_stress * sizeof(writer_tasks[0]),
+			       GFP_KERNEL);
+	if (writer_tasks == NULL) {
+		VERBOSE_PRINTK_STRING("writer_tasks: Out of memory");
+		firsterr = -ENOMEM;
+		goto unwind;
+	}
+	for (i = 0; i < nrealwriters_stress; i++) {
+		VERBOSE_PRINTK_STRING("Creating lock_torture_writer task");
+		writer_tasks[i] = kthread_run(lock_torture_writer, &lwsa[i],
+					      "lock_torture_writer");
+		if (IS_ERR(writer_tasks[i])) {
+			firsterr = PTR_ERR(writer_tasks[i]);
+			VERBOSE_PRINTK_STRING("Failed to create writer");
+			writer_tasks[i] = NULL;
+			goto unwind;
+		}
+	}
+	if (stat_interval > 0) {
+		VERBOSE_PRINTK_STRING("Creating lock_torture_stats task");
+		stats_task = kthread_run(lock_torture_stats, NULL,
+					 "lock_torture_stats");
+		if (IS_ERR(stats_task)) {
+			firsterr = PTR_ERR(stats_task);
+			VERBOSE_PRINTK_STRING("Failed to create stats");
+			stats_task = NULL;
+			goto unwind;
+		}
+	}
+	return 0;
+
+unwind:
+	lock_torture_cleanup();
+	return firsterr;
+}
+
+module_init(lock_torture_init);
+module_exit(lock_torture_cleanup);
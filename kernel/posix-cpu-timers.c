@@ -8,6 +8,7 @@
 #include <linux/math64.h>
 #include <asm/uaccess.h>
 #include <linux/kernel_stat.h>
+#include <linux/tick.h>
 #include <trace/events/timer.h>
 
 /*
@@ -598,6 +599,9 @@ static void arm_timer(struct k_itimer *timer)
 			break;
 		}
 	}
+
+	/* Expiry is checked from the tick, which may be stopped */
+	tick_nohz_full_kick_all();
 }
 
 /*
@@ -1415,7 +1419,29 @@ void set_process_cpu_timer(struct task_struct *tsk, unsigned int clock_idx,
 			tsk->signal->cputime_expires.virt_exp = *newval;
 		break;
 	}
+
+	tick_nohz_full_kick_all();
+}
+
+#ifdef CONFIG_NO_HZ_FULL
+/**
+ * posix_cpu_timers_can_stop_tick - check whether @tsk needs the tick
+ * @tsk:	the task running on a full dynticks CPU
+ *
+ * Timer expiry and cputimer sampling are driven by the tick, so it
+ * must keep running while @tsk or its thread group has timers armed.
+ */
+bool posix_cpu_timers_can_stop_tick(struct task_struct *tsk)
+{
+	if (!task_cputime_zero(&tsk->cputime_expires))
+		return false;
+
+	if (tsk->signal->cputimer.running)
+		return false;
+
+	return true;
 }
+#endif
 
 static int do_cpu_nanosleep(const clockid_t which_clock, int flags,
 			    struct timespec *rqtp, struct itimerspec *it)
@@ -1277,6 +1277,7 @@ void rcu_check_callbacks(int cpu, int user)
 	rcu_preempt_check_callbacks(cpu);
 	if (rcu_pending(cpu))
 		invoke_rcu_core();
+	do_nocb_deferred_wakeups(cpu);
 }
 
 #ifdef CONFIG_SMP
@@ -1479,9 +1480,15 @@ static void invoke_rcu_core(void)
 	raise_softirq(RCU_SOFTIRQ);
 }
 
+/*
+ * Queue a callback for invocation after a grace period.  Callbacks
+ * posted on a no-CBs CPU are handed to its rcuo kthread, unless @local
+ * is set, which the rcuo kthreads use to wait for grace periods
+ * without queueing behind the callbacks they are about to invoke.
+ */
 static void
 __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
-	   struct rcu_state *rsp)
+	   struct rcu_state *rsp, bool local)
 {
 	unsigned long flags;
 	struct rcu_data *rdp;
@@ -1501,6 +1508,12 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	local_irq_save(flags);
 	rdp = this_cpu_ptr(rsp->rda);
 
+	/* Offloaded CPUs leave their callbacks to their rcuo kthread. */
+	if (!local && __call_rcu_nocb(rdp, head, flags)) {
+		local_irq_restore(flags);
+		return;
+	}
+
 	/* Add the callback to our list. */
 	*rdp->nxttail[RCU_NEXT_TAIL] = head;
 	rdp->nxttail[RCU_NEXT_TAIL] = &head->next;
@@ -1551,7 +1564,7 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
  */
 void call_rcu_sched(struct rcu_head *head, void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, &rcu_sched_state);
+	__call_rcu(head, func, &rcu_sched_state, false);
 }
 EXPORT_SYMBOL_GPL(call_rcu_sched);
 
@@ -1560,7 +1573,7 @@ EXPORT_SYMBOL_GPL(call_rcu_sched);
  */
 void call_rcu_bh(struct rcu_head *head, void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, &rcu_bh_state);
+	__call_rcu(head, func, &rcu_bh_state, false);
 }
 EXPORT_SYMBOL_GPL(call_rcu_bh);
 
@@ -1712,6 +1725,20 @@ static int rcu_pending(int cpu)
 	       rcu_preempt_pending(cpu);
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Check whether RCU needs the scheduling-clock interrupt on a busy
+ * full dynticks CPU: either the CPU has callbacks, or a grace period
+ * waits for a quiescent state that only the tick reports for it.
+ * The reschedule IPIs sent by force_quiescent_state() to holdout CPUs
+ * restart the tick through this check.
+ */
+int rcu_nohz_full_needs_cpu(int cpu)
+{
+	return rcu_needs_cpu(cpu) || rcu_pending(cpu);
+}
+#endif /* #ifdef CONFIG_NO_HZ_FULL */
+
 /*
  * Check to see if any future RCU-related work will need to be done
  * by the current CPU, even if none need be done immediately, returning
@@ -1722,7 +1749,8 @@ static int rcu_needs_cpu_quick_check(int cpu)
 	/* RCU callbacks either ready or pending? */
 	return per_cpu(rcu_sched_data, cpu).nxtlist ||
 	       per_cpu(rcu_bh_data, cpu).nxtlist ||
-	       rcu_preempt_needs_cpu(cpu);
+	       rcu_preempt_needs_cpu(cpu) ||
+	       rcu_nocb_need_deferred_wakeup(cpu);
 }
 
 static DEFINE_PER_CPU(struct rcu_head, rcu_barrier_head) = {NULL};
@@ -1822,6 +1850,7 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	rdp->dynticks = &per_cpu(rcu_dynticks, cpu);
 #endif /* #ifdef CONFIG_NO_HZ */
 	rdp->cpu = cpu;
+	rcu_boot_init_nocb_percpu_data(rdp, rsp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
@@ -298,6 +298,18 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* 6) Callback offloading. */
+	struct rcu_head *nocb_head;	/* CBs waiting for kthread. */
+	struct rcu_head **nocb_tail;	/* NULL unless no-CBs CPU. */
+	atomic_long_t nocb_q_count;	/* # CBs waiting for kthread. */
+	unsigned long n_nocbs_invoked;	/* # CBs invoked by kthread. */
+	bool nocb_defer_wakeup;		/* Defer wakeup of nocb_kthread. */
+	wait_queue_head_t nocb_wq;	/* For nocb kthreads to sleep on. */
+	struct task_struct *nocb_kthread;
+	struct rcu_state *nocb_rsp;	/* Flavor the kthread waits on. */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
 };
 
@@ -466,5 +478,11 @@ static void rcu_yield(void (*f)(unsigned long), unsigned long arg);
 #endif /* #ifdef CONFIG_RCU_BOOST */
 static void rcu_cpu_kthread_setrt(int cpu, int to_rt);
 static void __cpuinit rcu_prepare_kthreads(int cpu);
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    unsigned long flags);
+static void do_nocb_deferred_wakeups(int cpu);
+static bool rcu_nocb_need_deferred_wakeup(int cpu);
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp,
+						  struct rcu_state *rsp);
 
 #endif /* #ifndef RCU_TREE_NONCORE */
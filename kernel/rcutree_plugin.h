@@ -616,7 +616,7 @@ static void rcu_preempt_do_callbacks(void)
  */
 void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu))
 {
-	__call_rcu(head, func, &rcu_preempt_state);
+	__call_rcu(head, func, &rcu_preempt_state, false);
 }
 EXPORT_SYMBOL_GPL(call_rcu);
 
@@ -1976,3 +1976,253 @@ static void rcu_needs_cpu_flush(void)
 }
 
 #endif /* #else #if !defined(CONFIG_RCU_FAST_NO_HZ) */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offload callback invocation from the CPUs listed in the rcu_nocbs=
+ * boot parameter.  Their call_rcu() requests are queued locklessly
+ * on a per-CPU, per-flavor list which is drained by an "rcuo" kthread.
+ * The kthread waits for a grace period on behalf of the whole batch
+ * and then invokes it in process context.  The kthreads are not bound
+ * to any CPU, so that they can be confined to housekeeping CPUs.
+ *
+ * The no-CBs CPUs still take part in grace periods: only the callback
+ * invocation moves away from them.
+ */
+
+static cpumask_var_t rcu_nocb_mask; /* CPUs to have callbacks offloaded. */
+static bool have_rcu_nocb_mask;	    /* Was rcu_nocb_mask allocated? */
+
+/*
+ * Parse the boot-time rcu_nocbs= CPU list.  The boot CPU is kept out of
+ * it: callbacks posted before the kthreads exist would otherwise wait
+ * for them, and some early boot paths wait for those callbacks.
+ */
+static int __init rcu_nocb_setup(char *str)
+{
+	int cpu = smp_processor_id();
+
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	have_rcu_nocb_mask = true;
+	cpulist_parse(str, rcu_nocb_mask);
+	if (cpumask_test_cpu(cpu, rcu_nocb_mask)) {
+		printk(KERN_INFO "\tRCU: CPU %d cannot be a no-CBs CPU.\n",
+		       cpu);
+		cpumask_clear_cpu(cpu, rcu_nocb_mask);
+	}
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+/* Is the specified CPU a no-CBs CPU? */
+static bool is_nocb_cpu(int cpu)
+{
+	if (have_rcu_nocb_mask)
+		return cpumask_test_cpu(cpu, rcu_nocb_mask);
+	return false;
+}
+
+/*
+ * Enqueue the callback on the no-CBs list of the specified rcu_data
+ * structure, and wake up its rcuo kthread if the list was empty.
+ * Returns false if the CPU is not a no-CBs CPU.  Called with interrupts
+ * disabled.  If they were already disabled by the caller, which might
+ * hold scheduler locks, the wakeup is left to the next scheduling-clock
+ * interrupt.
+ */
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    unsigned long flags)
+{
+	struct rcu_head **old_rhpp;
+	struct task_struct *t;
+
+	if (!rdp->nocb_tail)
+		return false;
+
+	old_rhpp = xchg(&rdp->nocb_tail, &rhp->next);
+	ACCESS_ONCE(*old_rhpp) = rhp;
+	atomic_long_inc(&rdp->nocb_q_count);
+
+	/* Only the first callback of a batch needs to wake the kthread. */
+	t = ACCESS_ONCE(rdp->nocb_kthread);
+	if (t == NULL || old_rhpp != &rdp->nocb_head)
+		return true;
+	if (irqs_disabled_flags(flags))
+		rdp->nocb_defer_wakeup = true;
+	else
+		wake_up(&rdp->nocb_wq);
+	return true;
+}
+
+/*
+ * Wait for a grace period of the rcuo kthread's flavor.  The callback is
+ * queued on the current CPU's own list, as queueing it on a no-CBs list
+ * could make it wait behind the very callbacks we are about to invoke.
+ */
+static void rcu_nocb_wait_gp(struct rcu_data *rdp)
+{
+	struct rcu_synchronize rcu;
+
+	init_rcu_head_on_stack(&rcu.head);
+	init_completion(&rcu.completion);
+	__call_rcu(&rcu.head, wakeme_after_rcu, rdp->nocb_rsp, true);
+	wait_for_completion(&rcu.completion);
+	destroy_rcu_head_on_stack(&rcu.head);
+}
+
+/*
+ * Per-CPU, per-flavor kthread which invokes the callbacks of a no-CBs
+ * CPU: grab the whole list, wait for a grace period, invoke it.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	long c;
+	struct rcu_head *list;
+	struct rcu_head *next;
+	struct rcu_head **tail;
+	struct rcu_data *rdp = arg;
+
+	for (;;) {
+		wait_event_interruptible(rdp->nocb_wq,
+					 ACCESS_ONCE(rdp->nocb_head));
+		list = ACCESS_ONCE(rdp->nocb_head);
+		if (!list)
+			continue;
+
+		/* Move callbacks to wait-for-GP list, which is empty. */
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+		rcu_nocb_wait_gp(rdp);
+
+		/* Each pass through the following loop invokes a callback. */
+		c = 0;
+		while (list) {
+			next = list->next;
+			/* Wait for enqueuing to complete, if needed. */
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = list->next;
+			}
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			__rcu_reclaim(list);
+			local_bh_enable();
+			list = next;
+			c++;
+			cond_resched();
+		}
+		atomic_long_sub(c, &rdp->nocb_q_count);
+		rdp->n_nocbs_invoked += c;
+	}
+	return 0;
+}
+
+/* Do a wakeup of an rcuo kthread that __call_rcu_nocb() had to defer. */
+static void do_nocb_deferred_wakeup(struct rcu_data *rdp)
+{
+	if (!ACCESS_ONCE(rdp->nocb_defer_wakeup))
+		return;
+	rdp->nocb_defer_wakeup = false;
+	wake_up(&rdp->nocb_wq);
+}
+
+/*
+ * Do the deferred rcuo kthread wakeups of all flavors for the specified
+ * CPU.  Called from the scheduling-clock interrupt.
+ */
+static void do_nocb_deferred_wakeups(int cpu)
+{
+	do_nocb_deferred_wakeup(&per_cpu(rcu_sched_data, cpu));
+	do_nocb_deferred_wakeup(&per_cpu(rcu_bh_data, cpu));
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	do_nocb_deferred_wakeup(&per_cpu(rcu_preempt_data, cpu));
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+}
+
+/*
+ * Does the specified CPU have a deferred rcuo kthread wakeup pending?
+ * If so, it needs the scheduling-clock interrupt to do it.
+ */
+static bool rcu_nocb_need_deferred_wakeup(int cpu)
+{
+	return ACCESS_ONCE(per_cpu(rcu_sched_data, cpu).nocb_defer_wakeup) ||
+	       ACCESS_ONCE(per_cpu(rcu_bh_data, cpu).nocb_defer_wakeup) ||
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	       ACCESS_ONCE(per_cpu(rcu_preempt_data, cpu).nocb_defer_wakeup) ||
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	       0;
+}
+
+/* Initialize the no-CBs fields of the specified CPU's rcu_data. */
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp,
+						  struct rcu_state *rsp)
+{
+	rdp->nocb_head = NULL;
+	rdp->nocb_tail = is_nocb_cpu(rdp->cpu) ? &rdp->nocb_head : NULL;
+	atomic_long_set(&rdp->nocb_q_count, 0);
+	init_waitqueue_head(&rdp->nocb_wq);
+	rdp->nocb_rsp = rsp;
+}
+
+/* Create the rcuo kthread of the specified flavor and no-CBs CPU. */
+static void __init rcu_spawn_one_nocb_kthread(struct rcu_state *rsp, int cpu,
+					      char abbr)
+{
+	struct rcu_data *rdp = per_cpu_ptr(rsp->rda, cpu);
+	struct task_struct *t;
+
+	t = kthread_run(rcu_nocb_kthread, rdp, "rcuo%c/%d", abbr, cpu);
+	BUG_ON(IS_ERR(t));
+	ACCESS_ONCE(rdp->nocb_kthread) = t;
+}
+
+/*
+ * Create the rcuo kthreads of all no-CBs CPUs.  Callbacks queued
+ * before that are picked up when the kthreads start.
+ */
+static int __init rcu_spawn_nocb_kthreads(void)
+{
+	char buf[80];
+	int cpu;
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+	cpulist_scnprintf(buf, sizeof(buf), rcu_nocb_mask);
+	printk(KERN_INFO "\tOffload RCU callbacks from CPUs: %s.\n", buf);
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		if (!cpu_possible(cpu))
+			continue;
+		rcu_spawn_one_nocb_kthread(&rcu_sched_state, cpu, 's');
+		rcu_spawn_one_nocb_kthread(&rcu_bh_state, cpu, 'b');
+#ifdef CONFIG_TREE_PREEMPT_RCU
+		rcu_spawn_one_nocb_kthread(&rcu_preempt_state, cpu, 'p');
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	}
+	return 0;
+}
+early_initcall(rcu_spawn_nocb_kthreads);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    unsigned long flags)
+{
+	return false;
+}
+
+static void do_nocb_deferred_wakeups(int cpu)
+{
+}
+
+static bool rcu_nocb_need_deferred_wakeup(int cpu)
+{
+	return false;
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp,
+						  struct rcu_state *rsp)
+{
+}
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -294,7 +294,12 @@ out_bc:
 static void tick_handover_do_timer(int *cpup)
 {
 	if (*cpup == tick_do_timer_cpu) {
-		int cpu = cpumask_first(cpu_online_mask);
+		int cpu;
+
+		/* Full dynticks CPUs can't keep the timekeeping going */
+		for_each_online_cpu(cpu)
+			if (!tick_nohz_full_cpu(cpu))
+				break;
 
 		tick_do_timer_cpu = (cpu < nr_cpu_ids) ? cpu :
 			TICK_DO_TIMER_NONE;
@@ -15,8 +15,10 @@
 #include <linux/err.h>
 #include <linux/hrtimer.h>
 #include <linux/interrupt.h>
+#include <linux/irq_work.h>
 #include <linux/kernel_stat.h>
 #include <linux/percpu.h>
+#include <linux/posix-timers.h>
 #include <linux/profile.h>
 #include <linux/sched.h>
 #include <linux/module.h>
@@ -25,6 +27,8 @@
 
 #include "tick-internal.h"
 
+#include <trace/events/timer.h>
+
 /*
  * Per cpu nohz control structure
  */
@@ -123,6 +127,39 @@ static int __init setup_tick_nohz(char *str)
 
 __setup("nohz=", setup_tick_nohz);
 
+#ifdef CONFIG_NO_HZ_FULL
+cpumask_var_t tick_nohz_full_mask;
+bool tick_nohz_full_running;
+
+/*
+ * Parse the set of CPUs on which the tick may be stopped while they
+ * run a single task. The boot CPU keeps the do_timer() duty, so it
+ * can't be part of it.
+ */
+static int __init tick_nohz_full_setup(char *str)
+{
+	int cpu = smp_processor_id();
+
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		printk(KERN_WARNING "NOHZ: Incorrect nohz_full cpumask\n");
+		return 1;
+	}
+
+	if (cpumask_test_cpu(cpu, tick_nohz_full_mask)) {
+		printk(KERN_WARNING "NOHZ: Clearing %d from nohz_full range "
+		       "for timekeeping\n", cpu);
+		cpumask_clear_cpu(cpu, tick_nohz_full_mask);
+	}
+	tick_nohz_full_running = !cpumask_empty(tick_nohz_full_mask);
+
+	return 1;
+}
+__setup("nohz_full=", tick_nohz_full_setup);
+
+static void tick_nohz_full_restart_tick(struct tick_sched *ts, ktime_t now);
+#endif
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -276,6 +313,19 @@ void tick_nohz_stop_sched_tick(int inidle)
 	if (!inidle && !ts->inidle)
 		goto end;
 
+#ifdef CONFIG_NO_HZ_FULL
+	/*
+	 * The tick may have been stopped while a task was running here.
+	 * Its skipped ticks were charged to it when it switched out, so
+	 * don't let idle inherit any: just restart from a running tick,
+	 * so that the idle bookkeeping below starts from a clean state.
+	 */
+	if (ts->tick_stopped && !ts->inidle) {
+		ts->full_jiffies = jiffies;
+		tick_nohz_full_restart_tick(ts, ktime_get());
+	}
+#endif
+
 	/*
 	 * Set ts->inidle unconditionally. Even if the system did not
 	 * switch to NOHZ mode the cpu frequency governers rely on the
@@ -332,6 +382,14 @@ void tick_nohz_stop_sched_tick(int inidle)
 		next_jiffies = get_next_timer_interrupt(last_jiffies);
 		delta_jiffies = next_jiffies - last_jiffies;
 	}
+	/*
+	 * Full dynticks CPUs never take the do_timer() duty, so the CPU
+	 * which owns it has to keep its tick running for them.
+	 */
+	if (tick_nohz_full_enabled() && cpu == tick_do_timer_cpu) {
+		next_jiffies = last_jiffies + 1;
+		delta_jiffies = 1;
+	}
 	/*
 	 * Do not stop the tick, if we are only one off
 	 * or if the cpu is required for rcu
@@ -552,6 +610,257 @@ void tick_nohz_restart_sched_tick(void)
 	local_irq_enable();
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Even with a single task, the scheduler, RCU and time accounting need
+ * to see a tick now and then. Don't defer it by more than a second.
+ */
+#define TICK_NOHZ_FULL_MAX_DEFERMENT	HZ
+
+static bool can_stop_full_tick(int cpu)
+{
+	WARN_ON_ONCE(!irqs_disabled());
+
+	if (!sched_can_stop_tick()) {
+		trace_tick_stop(0, "more than 1 task in runqueue\n");
+		return false;
+	}
+
+	if (!posix_cpu_timers_can_stop_tick(current)) {
+		trace_tick_stop(0, "posix timers running\n");
+		return false;
+	}
+
+	if (rcu_nohz_full_needs_cpu(cpu)) {
+		trace_tick_stop(0, "RCU needs the CPU\n");
+		return false;
+	}
+
+	if (printk_needs_cpu(cpu) || arch_needs_cpu(cpu)) {
+		trace_tick_stop(0, "printk or arch needs the CPU\n");
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Remember whether the interrupt came from user mode: that is the best
+ * guess there is for where the task spent the ticks we skip.
+ */
+static void tick_nohz_full_note_mode(struct tick_sched *ts)
+{
+	struct pt_regs *regs = get_irq_regs();
+
+	ts->full_user = !regs || user_mode(regs);
+}
+
+/*
+ * update_process_times() accounts a single tick. Charge the ticks
+ * which were skipped while the tick was stopped on a busy CPU to the
+ * task which ran meanwhile.
+ */
+static void __tick_nohz_full_account_ticks(struct tick_sched *ts)
+{
+#ifndef CONFIG_VIRT_CPU_ACCOUNTING
+	unsigned long ticks = jiffies - ts->full_jiffies;
+	cputime_t delta;
+
+	ts->full_jiffies = jiffies;
+	/*
+	 * We might be one off. Do not randomly account a huge number of ticks!
+	 */
+	if (!ticks || ticks >= LONG_MAX)
+		return;
+
+	delta = jiffies_to_cputime(ticks);
+	if (ts->full_user)
+		account_user_time(current, delta, cputime_to_scaled(delta));
+	else
+		account_system_time(current, HARDIRQ_OFFSET, delta,
+				    cputime_to_scaled(delta));
+#endif
+}
+
+static void tick_nohz_full_account_ticks(struct tick_sched *ts)
+{
+	if (!ts->tick_stopped || ts->inidle)
+		return;
+
+	/* The tick being handled is accounted by update_process_times() */
+	ts->full_jiffies++;
+	tick_nohz_full_note_mode(ts);
+	__tick_nohz_full_account_ticks(ts);
+}
+
+static void tick_nohz_full_restart_tick(struct tick_sched *ts, ktime_t now)
+{
+	__tick_nohz_full_account_ticks(ts);
+	ts->tick_stopped = 0;
+	tick_nohz_restart(ts, now);
+}
+
+static void tick_nohz_full_stop_tick(struct tick_sched *ts)
+{
+	struct clock_event_device *dev = __get_cpu_var(tick_cpu_device).evtdev;
+	unsigned long seq, last_jiffies, next_jiffies, delta_jiffies;
+	ktime_t last_update, expires;
+
+	do {
+		seq = read_seqbegin(&xtime_lock);
+		last_update = last_jiffies_update;
+		last_jiffies = jiffies;
+	} while (read_seqretry(&xtime_lock, seq));
+
+	next_jiffies = get_next_timer_interrupt(last_jiffies);
+	delta_jiffies = min_t(unsigned long, next_jiffies - last_jiffies,
+			      TICK_NOHZ_FULL_MAX_DEFERMENT);
+
+	/* Do not stop the tick, if we are only one off */
+	if (!ts->tick_stopped && delta_jiffies <= 1)
+		return;
+
+	expires = ktime_add_ns(last_update, tick_period.tv64 * delta_jiffies);
+
+	/* Skip reprogram of event if its not changed */
+	if (ts->tick_stopped && ktime_equal(expires, dev->next_event))
+		return;
+
+	if (!ts->tick_stopped) {
+		ts->idle_tick = hrtimer_get_expires(&ts->sched_timer);
+		ts->tick_stopped = 1;
+		ts->full_jiffies = last_jiffies;
+		trace_tick_stop(1, "");
+	}
+
+	if (ts->nohz_mode == NOHZ_MODE_HIGHRES) {
+		hrtimer_start(&ts->sched_timer, expires,
+			      HRTIMER_MODE_ABS_PINNED);
+		/* Check, if the timer was already in the past */
+		if (hrtimer_active(&ts->sched_timer))
+			return;
+	} else if (!tick_program_event(expires, 0))
+		return;
+
+	/* We are past the event already, go back to the periodic tick */
+	tick_nohz_full_restart_tick(ts, ktime_get());
+}
+
+/**
+ * tick_nohz_full_irq_exit - stop or restart the tick of a busy CPU
+ *
+ * Called from irq_exit() when a full dynticks CPU is not idle. The tick
+ * is stopped while a single task runs and nothing else needs it, and
+ * restarted as soon as this is no longer the case.
+ */
+void tick_nohz_full_irq_exit(void)
+{
+	int cpu = smp_processor_id();
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+
+	if (!tick_nohz_full_cpu(cpu) || ts->inidle ||
+	    ts->nohz_mode == NOHZ_MODE_INACTIVE)
+		return;
+
+	tick_nohz_full_note_mode(ts);
+	if (can_stop_full_tick(cpu))
+		tick_nohz_full_stop_tick(ts);
+	else if (ts->tick_stopped)
+		tick_nohz_full_restart_tick(ts, ktime_get());
+}
+
+/**
+ * __tick_nohz_full_task_switch - charge the skipped ticks on context switch
+ *
+ * Called with interrupts disabled by the task being switched out. The
+ * ticks skipped so far belong to it: flush them now, rather than charge
+ * them to whatever runs next once the tick restarts, idle in particular.
+ */
+void __tick_nohz_full_task_switch(void)
+{
+	struct tick_sched *ts = &__get_cpu_var(tick_cpu_sched);
+
+	if (ts->tick_stopped && !ts->inidle)
+		__tick_nohz_full_account_ticks(ts);
+}
+
+static void nohz_full_kick_work_func(struct irq_work *work)
+{
+	/* Nothing to do here, irq_exit() reevaluates the tick */
+}
+
+static DEFINE_PER_CPU(struct irq_work, nohz_full_kick_work) = {
+	.func = nohz_full_kick_work_func,
+};
+
+/**
+ * tick_nohz_full_kick_cpu - make a full dynticks CPU reevaluate its tick
+ * @cpu:	the CPU to kick
+ *
+ * Used when something which needs the tick shows up on @cpu, like a
+ * second runnable task. The interrupt sent to @cpu ends in irq_exit(),
+ * which restarts the tick if needed.
+ */
+void tick_nohz_full_kick_cpu(int cpu)
+{
+	if (!tick_nohz_full_cpu(cpu))
+		return;
+
+	if (cpu == smp_processor_id())
+		irq_work_queue(&__get_cpu_var(nohz_full_kick_work));
+	else
+		smp_send_reschedule(cpu);
+}
+
+/**
+ * tick_nohz_full_kick_all - make all full dynticks CPUs reevaluate their tick
+ */
+void tick_nohz_full_kick_all(void)
+{
+	int cpu;
+
+	if (!tick_nohz_full_running)
+		return;
+
+	preempt_disable();
+	for_each_cpu_and(cpu, tick_nohz_full_mask, cpu_online_mask)
+		tick_nohz_full_kick_cpu(cpu);
+	preempt_enable();
+}
+
+/*
+ * Full dynticks CPUs never take the do_timer() duty, so at least one
+ * other CPU must stay online to keep the timekeeping going.
+ */
+static int __cpuinit tick_nohz_full_cpu_down_callback(struct notifier_block *nfb,
+						     unsigned long action,
+						     void *hcpu)
+{
+	int cpu = (long)hcpu, other;
+
+	if (action != CPU_DOWN_PREPARE || tick_nohz_full_cpu(cpu))
+		return NOTIFY_OK;
+
+	for_each_online_cpu(other)
+		if (other != cpu && !tick_nohz_full_cpu(other))
+			return NOTIFY_OK;
+
+	printk(KERN_WARNING "NOHZ: Refusing to offline CPU %d, the last one "
+	       "outside the nohz_full range\n", cpu);
+	return NOTIFY_BAD;
+}
+
+static int __init tick_nohz_full_init(void)
+{
+	if (tick_nohz_full_running)
+		hotcpu_notifier(tick_nohz_full_cpu_down_callback, 0);
+	return 0;
+}
+early_initcall(tick_nohz_full_init);
+#else
+static inline void tick_nohz_full_account_ticks(struct tick_sched *ts) { }
+#endif /* CONFIG_NO_HZ_FULL */
+
 static int tick_nohz_reprogram(struct tick_sched *ts, ktime_t now)
 {
 	hrtimer_forward(&ts->sched_timer, now, tick_period);
@@ -575,9 +884,11 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	 * concurrency: This happens only when the cpu in charge went
 	 * into a long sleep. If two cpus happen to assign themself to
 	 * this duty, then the jiffies update is still serialized by
-	 * xtime_lock.
+	 * xtime_lock. Full dynticks CPUs may stop their tick at any
+	 * time, so they never take the duty.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 
 	/* Check, if the jiffies need an update */
@@ -595,6 +906,7 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	if (ts->tick_stopped) {
 		touch_softlockup_watchdog();
 		ts->idle_jiffies++;
+		tick_nohz_full_account_ticks(ts);
 	}
 
 	update_process_times(user_mode(regs));
@@ -695,6 +1007,7 @@ static inline void tick_check_nohz(int cpu)
 
 static inline void tick_nohz_switch_to_nohz(void) { }
 static inline void tick_check_nohz(int cpu) { }
+static inline void tick_nohz_full_account_ticks(struct tick_sched *ts) { }
 
 #endif /* NO_HZ */
 
@@ -729,9 +1042,11 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 	 * concurrency: This happens only when the cpu in charge went
 	 * into a long sleep. If two cpus happen to assign themself to
 	 * this duty, then the jiffies update is still serialized by
-	 * xtime_lock.
+	 * xtime_lock. Full dynticks CPUs may stop their tick at any
+	 * time, so they never take the duty.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 #endif
 
@@ -755,6 +1070,7 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 		if (ts->tick_stopped) {
 			touch_softlockup_watchdog();
 			ts->idle_jiffies++;
+			tick_nohz_full_account_ticks(ts);
 		}
 		update_process_times(user_mode(regs));
 		profile_tick(CPU_PROFILING);
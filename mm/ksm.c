@@ -78,20 +78,31 @@
  *    take 10 attempts to find a page in the unstable tree, once it is found,
  *    it is secured in the stable tree.  (When we scan a new page, we first
  *    compare it against the stable tree, and then against the unstable tree.)
+ *
+ * The mms registered with KSM are partitioned between several ksmd threads,
+ * each scanning its own list of mms with its own cursor.  The threads share
+ * the trees: each node has its own pair of stable and unstable trees, with
+ * a mutex serializing the threads working on them.  Pages are only merged
+ * with pages of the same node unless merge_across_nodes is set, in which
+ * case all pages go into the trees of node 0.  The unstable trees can only
+ * be flushed once every thread has completed its full scan, so a thread
+ * which finishes early waits for the others before starting the next one.
  */
 
 /**
  * struct mm_slot - ksm information per mm that is being scanned
  * @link: link to the mm_slots hash list
- * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
+ * @mm_list: link into the mm_slots list, rooted in its worker's mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @worker: the ksmd thread which scans this mm
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	struct ksm_worker *worker;
 };
 
 /**
@@ -99,9 +110,9 @@ struct mm_slot {
  * @mm_slot: the current mm_slot we are scanning
  * @address: the next address inside that to be scanned
  * @rmap_list: link to the next rmap to be scanned in the rmap_list
- * @seqnr: count of completed full scans (needed when removing unstable node)
+ * @seqnr: the full scan this cursor is working on
  *
- * There is only the one ksm_scan instance of this cursor structure.
+ * There is one ksm_scan instance of this cursor structure per ksm_worker.
  */
 struct ksm_scan {
 	struct mm_slot *mm_slot;
@@ -110,16 +121,48 @@ struct ksm_scan {
 	unsigned long seqnr;
 };
 
+/**
+ * struct ksm_worker - a ksmd thread and the mms it scans
+ * @mm_head: head of the list of mm_slots scanned by this thread
+ * @scan: the cursor of this thread
+ * @free_list: rmap_items unlinked under mmap_sem, to be freed without it
+ * @nr_mm_slots: number of mm_slots on the list
+ * @nid: the node this thread runs on
+ * @task: the ksmd thread itself
+ */
+struct ksm_worker {
+	struct mm_slot mm_head;
+	struct ksm_scan scan;
+	struct rmap_item *free_list;
+	unsigned long nr_mm_slots;
+	int nid;
+	struct task_struct *task;
+};
+
+/**
+ * struct ksm_tree - the stable and unstable trees of a node
+ * @stable: root of the stable tree
+ * @unstable: root of the unstable tree
+ * @mutex: serializes the ksmd threads using these trees
+ */
+struct ksm_tree {
+	struct rb_root stable;
+	struct rb_root unstable;
+	struct mutex mutex;
+};
+
 /**
  * struct stable_node - node of the stable rbtree
  * @node: rb node of this ksm page in the stable tree
  * @hlist: hlist head of rmap_items using this ksm page
  * @kpfn: page frame number of this ksm page
+ * @nid: index of the ksm_tree holding this node
  */
 struct stable_node {
 	struct rb_node node;
 	struct hlist_head hlist;
 	unsigned long kpfn;
+	int nid;
 };
 
 /**
@@ -129,6 +172,7 @@ struct stable_node {
  * @mm: the memory structure this rmap_item is pointing into
  * @address: the virtual address this rmap_item tracks (+ flags in low bits)
  * @oldchecksum: previous checksum of the page at that virtual address
+ * @nid: index of the ksm_tree this rmap_item was last linked into
  * @node: rb node of this rmap_item in the unstable tree
  * @head: pointer to stable_node heading this list in the stable tree
  * @hlist: link into hlist of rmap_items hanging off that stable_node
@@ -139,6 +183,7 @@ struct rmap_item {
 	struct mm_struct *mm;
 	unsigned long address;		/* + low bits used for flags below */
 	unsigned int oldchecksum;	/* when unstable */
+	int nid;			/* when stable or unstable */
 	union {
 		struct rb_node node;	/* when node of unstable tree */
 		struct {		/* when listed from stable tree */
@@ -152,50 +197,68 @@ struct rmap_item {
 #define UNSTABLE_FLAG	0x100	/* is a node of the unstable tree */
 #define STABLE_FLAG	0x200	/* is listed from the stable tree */
 
-/* The stable and unstable tree heads */
-static struct rb_root root_stable_tree = RB_ROOT;
-static struct rb_root root_unstable_tree = RB_ROOT;
+/* The stable and unstable trees, one pair per node */
+static struct ksm_tree *ksm_trees;
 
 #define MM_SLOTS_HASH_SHIFT 10
 #define MM_SLOTS_HASH_HEADS (1 << MM_SLOTS_HASH_SHIFT)
 static struct hlist_head mm_slots_hash[MM_SLOTS_HASH_HEADS];
 
-static struct mm_slot ksm_mm_head = {
-	.mm_list = LIST_HEAD_INIT(ksm_mm_head.mm_list),
-};
-static struct ksm_scan ksm_scan = {
-	.mm_slot = &ksm_mm_head,
-};
+/* The ksmd threads: one per online node unless ksm_threads= says otherwise */
+static struct ksm_worker *ksm_workers;
+static unsigned int ksm_nr_workers;
+
+/* The number of mm_slots on all the workers' lists */
+static unsigned long ksm_nr_mm_slots;
+
+/* Count of completed full scans (needed when removing unstable node) */
+static unsigned long ksm_seqnr;
+
+/* The number of ksmd threads which have completed the current full scan */
+static atomic_t ksm_workers_done = ATOMIC_INIT(0);
 
 static struct kmem_cache *rmap_item_cache;
 static struct kmem_cache *stable_node_cache;
 static struct kmem_cache *mm_slot_cache;
 
+/*
+ * The statistics below are updated by all the ksmd threads, under the
+ * mutex of whichever tree they are working on: so they are atomic.
+ */
+
 /* The number of nodes in the stable tree */
-static unsigned long ksm_pages_shared;
+static atomic_long_t ksm_pages_shared = ATOMIC_LONG_INIT(0);
 
 /* The number of page slots additionally sharing those nodes */
-static unsigned long ksm_pages_sharing;
+static atomic_long_t ksm_pages_sharing = ATOMIC_LONG_INIT(0);
 
 /* The number of nodes in the unstable tree */
-static unsigned long ksm_pages_unshared;
+static atomic_long_t ksm_pages_unshared = ATOMIC_LONG_INIT(0);
 
 /* The number of rmap_items in use: to calculate pages_volatile */
-static unsigned long ksm_rmap_items;
+static atomic_long_t ksm_rmap_items = ATOMIC_LONG_INIT(0);
 
-/* Number of pages ksmd should scan in one batch */
+/* Number of pages each ksmd thread should scan in one batch */
 static unsigned int ksm_thread_pages_to_scan = 100;
 
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+#ifdef CONFIG_NUMA
+/* Zeroed when merging across nodes is not allowed */
+static unsigned int ksm_merge_across_nodes = 1;
+#else
+#define ksm_merge_across_nodes	1U
+#endif
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
 static unsigned int ksm_run = KSM_RUN_STOP;
 
 static DECLARE_WAIT_QUEUE_HEAD(ksm_thread_wait);
-static DEFINE_MUTEX(ksm_thread_mutex);
+/* Taken for read by ksmd threads, for write to lock them all out */
+static DECLARE_RWSEM(ksm_thread_sem);
 static DEFINE_SPINLOCK(ksm_mmlist_lock);
 
 #define KSM_KMEM_CACHE(__struct, __flags) kmem_cache_create("ksm_"#__struct,\
@@ -240,13 +303,13 @@ static inline struct rmap_item *alloc_rmap_item(void)
 
 	rmap_item = kmem_cache_zalloc(rmap_item_cache, GFP_KERNEL);
 	if (rmap_item)
-		ksm_rmap_items++;
+		atomic_long_inc(&ksm_rmap_items);
 	return rmap_item;
 }
 
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
-	ksm_rmap_items--;
+	atomic_long_dec(&ksm_rmap_items);
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -302,6 +365,15 @@ static inline int in_stable_tree(struct rmap_item *rmap_item)
 	return rmap_item->address & STABLE_FLAG;
 }
 
+/*
+ * The index of the ksm_tree in which to look for, or to insert, the page
+ * at kpfn: always 0 if merge_across_nodes is set, the node id otherwise.
+ */
+static inline int get_kpfn_nid(unsigned long kpfn)
+{
+	return ksm_merge_across_nodes ? 0 : pfn_to_nid(kpfn);
+}
+
 /*
  * ksmd, and unmerge_and_remove_all_rmap_items(), must not touch an mm's
  * page tables after it has passed through ksm_exit() - which, if necessary,
@@ -443,6 +515,10 @@ out:		page = NULL;
 	return page;
 }
 
+/*
+ * Called with the mutex of the ksm_tree holding stable_node, or with
+ * ksm_thread_sem held for write.
+ */
 static void remove_node_from_stable_tree(struct stable_node *stable_node)
 {
 	struct rmap_item *rmap_item;
@@ -450,15 +526,15 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 
 	hlist_for_each_entry(rmap_item, hlist, &stable_node->hlist, hlist) {
 		if (rmap_item->hlist.next)
-			ksm_pages_sharing--;
+			atomic_long_dec(&ksm_pages_sharing);
 		else
-			ksm_pages_shared--;
+			atomic_long_dec(&ksm_pages_shared);
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
 		cond_resched();
 	}
 
-	rb_erase(&stable_node->node, &root_stable_tree);
+	rb_erase(&stable_node->node, &ksm_trees[stable_node->nid].stable);
 	free_stable_node(stable_node);
 }
 
@@ -480,7 +556,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
  * a page to put something that might look like our key in page->mapping.
  *
  * include/linux/pagemap.h page_cache_get_speculative() is a good reference,
- * but this is different - made simpler by ksm_thread_mutex being held, but
+ * but this is different - made simpler by the tree mutex being held, but
  * interesting for assuming that no other use of the struct page could ever
  * put our expected_mapping into page->mapping (or a field of the union which
  * coincides with page->mapping).  The RCU calls are not for KSM at all, but
@@ -519,8 +595,9 @@ stale:
 /*
  * Removing rmap_item from stable or unstable tree.
  * This function will clean the information from the stable/unstable tree.
+ * Called with the mutex of ksm_trees[rmap_item->nid] held.
  */
-static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
+static void __remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 {
 	if (rmap_item->address & STABLE_FLAG) {
 		struct stable_node *stable_node;
@@ -529,7 +606,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 		stable_node = rmap_item->head;
 		page = get_ksm_page(stable_node);
 		if (!page)
-			goto out;
+			return;
 
 		lock_page(page);
 		hlist_del(&rmap_item->hlist);
@@ -537,9 +614,9 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 		put_page(page);
 
 		if (stable_node->hlist.first)
-			ksm_pages_sharing--;
+			atomic_long_dec(&ksm_pages_sharing);
 		else
-			ksm_pages_shared--;
+			atomic_long_dec(&ksm_pages_shared);
 
 		put_anon_vma(rmap_item->anon_vma);
 		rmap_item->address &= PAGE_MASK;
@@ -548,31 +625,71 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 		unsigned char age;
 		/*
 		 * Usually ksmd can and must skip the rb_erase, because
-		 * root_unstable_tree was already reset to RB_ROOT.
+		 * the unstable tree was already reset to RB_ROOT.
 		 * But be careful when an mm is exiting: do the rb_erase
 		 * if this rmap_item was inserted by this scan, rather
 		 * than left over from before.
 		 */
-		age = (unsigned char)(ksm_scan.seqnr - rmap_item->address);
+		age = (unsigned char)(ksm_seqnr - rmap_item->address);
 		BUG_ON(age > 1);
 		if (!age)
-			rb_erase(&rmap_item->node, &root_unstable_tree);
+			rb_erase(&rmap_item->node,
+				 &ksm_trees[rmap_item->nid].unstable);
 
-		ksm_pages_unshared--;
+		atomic_long_dec(&ksm_pages_unshared);
 		rmap_item->address &= PAGE_MASK;
 	}
-out:
+}
+
+/*
+ * Only the ksmd thread scanning rmap_item->mm can link it into a tree,
+ * so if it is not in a tree, it stays out of them.  But another thread
+ * may move it from the unstable to the stable tree of the same ksm_tree
+ * meanwhile, so look again at the flags once we hold the mutex.
+ */
+static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
+{
+	if (rmap_item->address & (STABLE_FLAG | UNSTABLE_FLAG)) {
+		struct ksm_tree *tree = &ksm_trees[rmap_item->nid];
+
+		mutex_lock(&tree->mutex);
+		__remove_rmap_item_from_tree(rmap_item);
+		mutex_unlock(&tree->mutex);
+	}
 	cond_resched();		/* we're called from many long loops */
 }
 
+/*
+ * A ksmd thread must not take a tree mutex while holding mmap_sem: another
+ * thread holding that mutex may be waiting for the same mmap_sem, behind a
+ * writer.  So rmap_items unlinked under mmap_sem are queued on the worker,
+ * and removed from their tree and freed by free_deferred_rmap_items() once
+ * mmap_sem has been dropped.
+ */
+static inline void defer_free_rmap_item(struct ksm_worker *worker,
+					struct rmap_item *rmap_item)
+{
+	rmap_item->rmap_list = worker->free_list;
+	worker->free_list = rmap_item;
+}
+
+static void free_deferred_rmap_items(struct ksm_worker *worker)
+{
+	while (worker->free_list) {
+		struct rmap_item *rmap_item = worker->free_list;
+		worker->free_list = rmap_item->rmap_list;
+		remove_rmap_item_from_tree(rmap_item);
+		free_rmap_item(rmap_item);
+	}
+}
+
 static void remove_trailing_rmap_items(struct mm_slot *mm_slot,
 				       struct rmap_item **rmap_list)
 {
 	while (*rmap_list) {
 		struct rmap_item *rmap_item = *rmap_list;
 		*rmap_list = rmap_item->rmap_list;
-		remove_rmap_item_from_tree(rmap_item);
-		free_rmap_item(rmap_item);
+		defer_free_rmap_item(mm_slot->worker, rmap_item);
 	}
 }
 
@@ -612,58 +729,78 @@ static int unmerge_ksm_pages(struct vm_area_struct *vma,
  */
 static int unmerge_and_remove_all_rmap_items(void)
 {
+	struct ksm_worker *worker;
 	struct mm_slot *mm_slot;
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
+	int i, nid;
 	int err = 0;
 
-	spin_lock(&ksm_mmlist_lock);
-	ksm_scan.mm_slot = list_entry(ksm_mm_head.mm_list.next,
+	for (i = 0; i < ksm_nr_workers; i++) {
+		worker = &ksm_workers[i];
+
+		spin_lock(&ksm_mmlist_lock);
+		worker->scan.mm_slot = list_entry(worker->mm_head.mm_list.next,
 						struct mm_slot, mm_list);
-	spin_unlock(&ksm_mmlist_lock);
+		spin_unlock(&ksm_mmlist_lock);
 
-	for (mm_slot = ksm_scan.mm_slot;
-			mm_slot != &ksm_mm_head; mm_slot = ksm_scan.mm_slot) {
-		mm = mm_slot->mm;
-		down_read(&mm->mmap_sem);
-		for (vma = mm->mmap; vma; vma = vma->vm_next) {
-			if (ksm_test_exit(mm))
-				break;
-			if (!(vma->vm_flags & VM_MERGEABLE) || !vma->anon_vma)
-				continue;
-			err = unmerge_ksm_pages(vma,
+		for (mm_slot = worker->scan.mm_slot;
+		     mm_slot != &worker->mm_head;
+		     mm_slot = worker->scan.mm_slot) {
+			mm = mm_slot->mm;
+			down_read(&mm->mmap_sem);
+			for (vma = mm->mmap; vma; vma = vma->vm_next) {
+				if (ksm_test_exit(mm))
+					break;
+				if (!(vma->vm_flags & VM_MERGEABLE) ||
+				    !vma->anon_vma)
+					continue;
+				err = unmerge_ksm_pages(vma,
 						vma->vm_start, vma->vm_end);
-			if (err)
-				goto error;
-		}
+				if (err)
+					goto error;
+			}
 
-		remove_trailing_rmap_items(mm_slot, &mm_slot->rmap_list);
+			remove_trailing_rmap_items(mm_slot,
+						   &mm_slot->rmap_list);
 
-		spin_lock(&ksm_mmlist_lock);
-		ksm_scan.mm_slot = list_entry(mm_slot->mm_list.next,
+			spin_lock(&ksm_mmlist_lock);
+			worker->scan.mm_slot = list_entry(mm_slot->mm_list.next,
 						struct mm_slot, mm_list);
-		if (ksm_test_exit(mm)) {
-			hlist_del(&mm_slot->link);
-			list_del(&mm_slot->mm_list);
-			spin_unlock(&ksm_mmlist_lock);
-
-			free_mm_slot(mm_slot);
-			clear_bit(MMF_VM_MERGEABLE, &mm->flags);
-			up_read(&mm->mmap_sem);
-			mmdrop(mm);
-		} else {
-			spin_unlock(&ksm_mmlist_lock);
-			up_read(&mm->mmap_sem);
+			if (ksm_test_exit(mm)) {
+				hlist_del(&mm_slot->link);
+				list_del(&mm_slot->mm_list);
+				worker->nr_mm_slots--;
+				ksm_nr_mm_slots--;
+				spin_unlock(&ksm_mmlist_lock);
+
+				free_mm_slot(mm_slot);
+				clear_bit(MMF_VM_MERGEABLE, &mm->flags);
+				up_read(&mm->mmap_sem);
+				free_deferred_rmap_items(worker);
+				mmdrop(mm);
+			} else {
+				spin_unlock(&ksm_mmlist_lock);
+				up_read(&mm->mmap_sem);
+				free_deferred_rmap_items(worker);
+			}
 		}
 	}
 
-	ksm_scan.seqnr = 0;
+	/* Every rmap_item is gone: start afresh from the first full scan */
+	for (nid = 0; nid < nr_node_ids; nid++)
+		ksm_trees[nid].unstable = RB_ROOT;
+	for (i = 0; i < ksm_nr_workers; i++)
+		ksm_workers[i].scan.seqnr = 0;
+	atomic_set(&ksm_workers_done, 0);
+	ksm_seqnr = 0;
 	return 0;
 
 error:
 	up_read(&mm->mmap_sem);
+	free_deferred_rmap_items(worker);
 	spin_lock(&ksm_mmlist_lock);
-	ksm_scan.mm_slot = &ksm_mm_head;
+	worker->scan.mm_slot = &worker->mm_head;
 	spin_unlock(&ksm_mmlist_lock);
 	return err;
 }
@@ -983,9 +1120,9 @@ static struct page *try_to_merge_two_pages(struct rmap_item *rmap_item,
  * This function returns the stable tree node of identical content if found,
  * NULL otherwise.
  */
-static struct page *stable_tree_search(struct page *page)
+static struct page *stable_tree_search(struct page *page, int nid)
 {
-	struct rb_node *node = root_stable_tree.rb_node;
+	struct rb_node *node = ksm_trees[nid].stable.rb_node;
 	struct stable_node *stable_node;
 
 	stable_node = page_stable_node(page);
@@ -1026,9 +1163,10 @@ static struct page *stable_tree_search(struct page *page)
  * This function returns the stable tree node just allocated on success,
  * NULL otherwise.
  */
-static struct stable_node *stable_tree_insert(struct page *kpage)
+static struct stable_node *stable_tree_insert(struct page *kpage, int nid)
 {
-	struct rb_node **new = &root_stable_tree.rb_node;
+	struct rb_root *root = &ksm_trees[nid].stable;
+	struct rb_node **new = &root->rb_node;
 	struct rb_node *parent = NULL;
 	struct stable_node *stable_node;
 
@@ -1065,11 +1203,12 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
 		return NULL;
 
 	rb_link_node(&stable_node->node, parent, new);
-	rb_insert_color(&stable_node->node, &root_stable_tree);
+	rb_insert_color(&stable_node->node, root);
 
 	INIT_HLIST_HEAD(&stable_node->hlist);
 
 	stable_node->kpfn = page_to_pfn(kpage);
+	stable_node->nid = nid;
 	set_page_stable_node(kpage, stable_node);
 
 	return stable_node;
@@ -1091,11 +1230,12 @@ static struct stable_node *stable_tree_insert(struct page *kpage)
  */
 static
 struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
-					      struct page *page,
+					      struct page *page, int nid,
 					      struct page **tree_pagep)
 
 {
-	struct rb_node **new = &root_unstable_tree.rb_node;
+	struct rb_root *root = &ksm_trees[nid].unstable;
+	struct rb_node **new = &root->rb_node;
 	struct rb_node *parent = NULL;
 
 	while (*new) {
@@ -1117,6 +1257,16 @@ struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
 			return NULL;
 		}
 
+		/*
+		 * If tree_page has been migrated to another node since it
+		 * was inserted, it will go into the right unstable tree on
+		 * the next full scan: until then, don't merge with it.
+		 */
+		if (!ksm_merge_across_nodes && page_to_nid(tree_page) != nid) {
+			put_page(tree_page);
+			return NULL;
+		}
+
 		ret = memcmp_pages(page, tree_page);
 
 		parent = *new;
@@ -1133,11 +1283,12 @@ struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
 	}
 
 	rmap_item->address |= UNSTABLE_FLAG;
-	rmap_item->address |= (ksm_scan.seqnr & SEQNR_MASK);
+	rmap_item->address |= (ksm_seqnr & SEQNR_MASK);
+	rmap_item->nid = nid;
 	rb_link_node(&rmap_item->node, parent, new);
-	rb_insert_color(&rmap_item->node, &root_unstable_tree);
+	rb_insert_color(&rmap_item->node, root);
 
-	ksm_pages_unshared++;
+	atomic_long_inc(&ksm_pages_unshared);
 	return NULL;
 }
 
@@ -1150,13 +1301,14 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 			       struct stable_node *stable_node)
 {
 	rmap_item->head = stable_node;
+	rmap_item->nid = stable_node->nid;
 	rmap_item->address |= STABLE_FLAG;
 	hlist_add_head(&rmap_item->hlist, &stable_node->hlist);
 
 	if (rmap_item->hlist.next)
-		ksm_pages_sharing++;
+		atomic_long_inc(&ksm_pages_sharing);
 	else
-		ksm_pages_shared++;
+		atomic_long_inc(&ksm_pages_shared);
 }
 
 /*
@@ -1165,6 +1317,10 @@ static void stable_tree_append(struct rmap_item *rmap_item,
  * be inserted into the unstable tree, or merged with a page already there and
  * both transferred to the stable tree.
  *
+ * The trees searched are those of the page's node, unless merge_across_nodes
+ * is set: their mutex is held while working on them, but not while computing
+ * the checksum, which other ksmd threads can do in parallel.
+ *
  * @page: the page that we are searching identical page to.
  * @rmap_item: the reverse mapping into the virtual address of this page
  */
@@ -1173,14 +1329,20 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	struct rmap_item *tree_rmap_item;
 	struct page *tree_page = NULL;
 	struct stable_node *stable_node;
+	struct ksm_tree *tree;
 	struct page *kpage;
 	unsigned int checksum;
+	int nid;
 	int err;
 
 	remove_rmap_item_from_tree(rmap_item);
 
+	nid = get_kpfn_nid(page_to_pfn(page));
+	tree = &ksm_trees[nid];
+
 	/* We first start with searching the page inside the stable tree */
-	kpage = stable_tree_search(page);
+	mutex_lock(&tree->mutex);
+	kpage = stable_tree_search(page, nid);
 	if (kpage) {
 		err = try_to_merge_with_ksm_page(rmap_item, page, kpage);
 		if (!err) {
@@ -1193,8 +1355,10 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			unlock_page(kpage);
 		}
 		put_page(kpage);
+		mutex_unlock(&tree->mutex);
 		return;
 	}
+	mutex_unlock(&tree->mutex);
 
 	/*
 	 * If the hash value of the page has changed from the last time
@@ -1208,8 +1372,9 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 		return;
 	}
 
+	mutex_lock(&tree->mutex);
 	tree_rmap_item =
-		unstable_tree_search_insert(rmap_item, page, &tree_page);
+		unstable_tree_search_insert(rmap_item, page, nid, &tree_page);
 	if (tree_rmap_item) {
 		kpage = try_to_merge_two_pages(rmap_item, page,
 						tree_rmap_item, tree_page);
@@ -1220,10 +1385,10 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 		 * tree, and insert it instead as new node in the stable tree.
 		 */
 		if (kpage) {
-			remove_rmap_item_from_tree(tree_rmap_item);
+			__remove_rmap_item_from_tree(tree_rmap_item);
 
 			lock_page(kpage);
-			stable_node = stable_tree_insert(kpage);
+			stable_node = stable_tree_insert(kpage, nid);
 			if (stable_node) {
 				stable_tree_append(tree_rmap_item, stable_node);
 				stable_tree_append(rmap_item, stable_node);
@@ -1242,6 +1407,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			}
 		}
 	}
+	mutex_unlock(&tree->mutex);
 }
 
 static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
@@ -1257,8 +1423,7 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 		if (rmap_item->address > addr)
 			break;
 		*rmap_list = rmap_item->rmap_list;
-		remove_rmap_item_from_tree(rmap_item);
-		free_rmap_item(rmap_item);
+		defer_free_rmap_item(mm_slot->worker, rmap_item);
 	}
 
 	rmap_item = alloc_rmap_item();
@@ -1272,45 +1437,73 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
-static struct rmap_item *scan_get_next_rmap_item(struct page **page)
+/*
+ * Called by each ksmd thread when it has completed its full scan: the last
+ * one to get there flushes the unstable trees, and lets them all start on
+ * the next full scan.
+ */
+static void ksm_scan_done(struct ksm_worker *worker)
+{
+	int nid;
+
+	worker->scan.seqnr = ksm_seqnr + 1;
+	if (atomic_inc_return(&ksm_workers_done) < ksm_nr_workers)
+		return;
+
+	/*
+	 * A number of pages can hang around indefinitely on per-cpu
+	 * pagevecs, raised page count preventing write_protect_page
+	 * from merging them.  Though it doesn't really matter much,
+	 * it is puzzling to see some stuck in pages_volatile until
+	 * other activity jostles them out, and they also prevented
+	 * LTP's KSM test from succeeding deterministically; so drain
+	 * them here (here rather than on entry to ksm_do_scan(),
+	 * so we don't IPI too often when pages_to_scan is set low).
+	 */
+	lru_add_drain_all();
+
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		mutex_lock(&ksm_trees[nid].mutex);
+		ksm_trees[nid].unstable = RB_ROOT;
+		mutex_unlock(&ksm_trees[nid].mutex);
+	}
+
+	atomic_set(&ksm_workers_done, 0);
+	smp_wmb();		/* reset ksm_workers_done before next scan */
+	ksm_seqnr++;
+	wake_up_interruptible(&ksm_thread_wait);
+}
+
+static struct rmap_item *scan_get_next_rmap_item(struct ksm_worker *worker,
+						 struct page **page)
 {
+	struct ksm_scan *scan = &worker->scan;
 	struct mm_struct *mm;
 	struct mm_slot *slot;
 	struct vm_area_struct *vma;
 	struct rmap_item *rmap_item;
 
-	if (list_empty(&ksm_mm_head.mm_list))
-		return NULL;
-
-	slot = ksm_scan.mm_slot;
-	if (slot == &ksm_mm_head) {
-		/*
-		 * A number of pages can hang around indefinitely on per-cpu
-		 * pagevecs, raised page count preventing write_protect_page
-		 * from merging them.  Though it doesn't really matter much,
-		 * it is puzzling to see some stuck in pages_volatile until
-		 * other activity jostles them out, and they also prevented
-		 * LTP's KSM test from succeeding deterministically; so drain
-		 * them here (here rather than on entry to ksm_do_scan(),
-		 * so we don't IPI too often when pages_to_scan is set low).
-		 */
-		lru_add_drain_all();
-
-		root_unstable_tree = RB_ROOT;
+	slot = scan->mm_slot;
+	if (slot == &worker->mm_head) {
+		/* Wait for the other threads to complete the last full scan */
+		if (scan->seqnr != ksm_seqnr)
+			return NULL;
+		smp_rmb();
 
 		spin_lock(&ksm_mmlist_lock);
 		slot = list_entry(slot->mm_list.next, struct mm_slot, mm_list);
-		ksm_scan.mm_slot = slot;
+		scan->mm_slot = slot;
 		spin_unlock(&ksm_mmlist_lock);
 		/*
-		 * Although we tested list_empty() above, a racing __ksm_exit
-		 * of the last mm on the list may have removed it since then.
+		 * This thread may have been given no mm to scan, or a racing
+		 * __ksm_exit of the last mm on its list may have removed it.
+		 * It still has to take its part in completing the full scan.
 		 */
-		if (slot == &ksm_mm_head)
-			return NULL;
+		if (slot == &worker->mm_head)
+			goto done;
 next_mm:
-		ksm_scan.address = 0;
-		ksm_scan.rmap_list = &slot->rmap_list;
+		scan->address = 0;
+		scan->rmap_list = &slot->rmap_list;
 	}
 
 	mm = slot->mm;
@@ -1318,60 +1511,61 @@ next_mm:
 	if (ksm_test_exit(mm))
 		vma = NULL;
 	else
-		vma = find_vma(mm, ksm_scan.address);
+		vma = find_vma(mm, scan->address);
 
 	for (; vma; vma = vma->vm_next) {
 		if (!(vma->vm_flags & VM_MERGEABLE))
 			continue;
-		if (ksm_scan.address < vma->vm_start)
-			ksm_scan.address = vma->vm_start;
+		if (scan->address < vma->vm_start)
+			scan->address = vma->vm_start;
 		if (!vma->anon_vma)
-			ksm_scan.address = vma->vm_end;
+			scan->address = vma->vm_end;
 
-		while (ksm_scan.address < vma->vm_end) {
+		while (scan->address < vma->vm_end) {
 			if (ksm_test_exit(mm))
 				break;
-			*page = follow_page(vma, ksm_scan.address, FOLL_GET);
+			*page = follow_page(vma, scan->address, FOLL_GET);
 			if (IS_ERR_OR_NULL(*page)) {
-				ksm_scan.address += PAGE_SIZE;
+				scan->address += PAGE_SIZE;
 				cond_resched();
 				continue;
 			}
 			if (PageAnon(*page) ||
 			    page_trans_compound_anon(*page)) {
-				flush_anon_page(vma, *page, ksm_scan.address);
+				flush_anon_page(vma, *page, scan->address);
 				flush_dcache_page(*page);
 				rmap_item = get_next_rmap_item(slot,
-					ksm_scan.rmap_list, ksm_scan.address);
+					scan->rmap_list, scan->address);
 				if (rmap_item) {
-					ksm_scan.rmap_list =
+					scan->rmap_list =
 							&rmap_item->rmap_list;
-					ksm_scan.address += PAGE_SIZE;
+					scan->address += PAGE_SIZE;
 				} else
 					put_page(*page);
 				up_read(&mm->mmap_sem);
+				free_deferred_rmap_items(worker);
 				return rmap_item;
 			}
 			put_page(*page);
-			ksm_scan.address += PAGE_SIZE;
+			scan->address += PAGE_SIZE;
 			cond_resched();
 		}
 	}
 
 	if (ksm_test_exit(mm)) {
-		ksm_scan.address = 0;
-		ksm_scan.rmap_list = &slot->rmap_list;
+		scan->address = 0;
+		scan->rmap_list = &slot->rmap_list;
 	}
 	/*
 	 * Nuke all the rmap_items that are above this current rmap:
 	 * because there were no VM_MERGEABLE vmas with such addresses.
 	 */
-	remove_trailing_rmap_items(slot, ksm_scan.rmap_list);
+	remove_trailing_rmap_items(slot, scan->rmap_list);
 
 	spin_lock(&ksm_mmlist_lock);
-	ksm_scan.mm_slot = list_entry(slot->mm_list.next,
+	scan->mm_slot = list_entry(slot->mm_list.next,
 						struct mm_slot, mm_list);
-	if (ksm_scan.address == 0) {
+	if (scan->address == 0) {
 		/*
 		 * We've completed a full scan of all vmas, holding mmap_sem
 		 * throughout, and found no VM_MERGEABLE: so do the same as
@@ -1383,38 +1577,44 @@ next_mm:
 		 */
 		hlist_del(&slot->link);
 		list_del(&slot->mm_list);
+		worker->nr_mm_slots--;
+		ksm_nr_mm_slots--;
 		spin_unlock(&ksm_mmlist_lock);
 
 		free_mm_slot(slot);
 		clear_bit(MMF_VM_MERGEABLE, &mm->flags);
 		up_read(&mm->mmap_sem);
+		free_deferred_rmap_items(worker);
 		mmdrop(mm);
 	} else {
 		spin_unlock(&ksm_mmlist_lock);
 		up_read(&mm->mmap_sem);
+		free_deferred_rmap_items(worker);
 	}
 
 	/* Repeat until we've completed scanning the whole list */
-	slot = ksm_scan.mm_slot;
-	if (slot != &ksm_mm_head)
+	slot = scan->mm_slot;
+	if (slot != &worker->mm_head)
 		goto next_mm;
 
-	ksm_scan.seqnr++;
+done:
+	ksm_scan_done(worker);
 	return NULL;
 }
 
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
+ * @worker - the ksmd thread's own ksm_worker.
  * @scan_npages - number of pages we want to scan before we return.
  */
-static void ksm_do_scan(unsigned int scan_npages)
+static void ksm_do_scan(struct ksm_worker *worker, unsigned int scan_npages)
 {
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
 
 	while (scan_npages-- && likely(!freezing(current))) {
 		cond_resched();
-		rmap_item = scan_get_next_rmap_item(&page);
+		rmap_item = scan_get_next_rmap_item(worker, &page);
 		if (!rmap_item)
 			return;
 		if (!PageKsm(page) || !in_stable_tree(rmap_item))
@@ -1423,30 +1623,36 @@ static void ksm_do_scan(unsigned int scan_npages)
 	}
 }
 
-static int ksmd_should_run(void)
+static int ksmd_should_run(struct ksm_worker *worker)
 {
-	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
+	return (ksm_run & KSM_RUN_MERGE) && ksm_nr_mm_slots &&
+		worker->scan.seqnr == ksm_seqnr;
 }
 
-static int ksm_scan_thread(void *nothing)
+static int ksm_scan_thread(void *arg)
 {
+	struct ksm_worker *worker = arg;
+	const struct cpumask *cpumask = cpumask_of_node(worker->nid);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
 	set_freezable();
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
-		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
-		mutex_unlock(&ksm_thread_mutex);
+		down_read(&ksm_thread_sem);
+		if (ksmd_should_run(worker))
+			ksm_do_scan(worker, ksm_thread_pages_to_scan);
+		up_read(&ksm_thread_sem);
 
 		try_to_freeze();
 
-		if (ksmd_should_run()) {
+		if (ksmd_should_run(worker)) {
 			schedule_timeout_interruptible(
 				msecs_to_jiffies(ksm_thread_sleep_millisecs));
 		} else {
 			wait_event_freezable(ksm_thread_wait,
-				ksmd_should_run() || kthread_should_stop());
+				ksmd_should_run(worker) || kthread_should_stop());
 		}
 	}
 	return 0;
@@ -1495,8 +1701,31 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 	return 0;
 }
 
+/*
+ * Hand a new mm to the ksmd thread with the fewest mms among those running
+ * on the current node, where most of its pages are likely to be; or to the
+ * least loaded thread if none runs there.  Called under ksm_mmlist_lock.
+ */
+static struct ksm_worker *ksm_choose_worker(void)
+{
+	struct ksm_worker *worker, *best = NULL, *best_local = NULL;
+	int nid = numa_node_id();
+	int i;
+
+	for (i = 0; i < ksm_nr_workers; i++) {
+		worker = &ksm_workers[i];
+		if (!best || worker->nr_mm_slots < best->nr_mm_slots)
+			best = worker;
+		if (worker->nid == nid && (!best_local ||
+		    worker->nr_mm_slots < best_local->nr_mm_slots))
+			best_local = worker;
+	}
+	return best_local ? best_local : best;
+}
+
 int __ksm_enter(struct mm_struct *mm)
 {
+	struct ksm_worker *worker;
 	struct mm_slot *mm_slot;
 	int needs_wakeup;
 
@@ -1504,17 +1733,21 @@ int __ksm_enter(struct mm_struct *mm)
 	if (!mm_slot)
 		return -ENOMEM;
 
+	spin_lock(&ksm_mmlist_lock);
 	/* Check ksm_run too?  Would need tighter locking */
-	needs_wakeup = list_empty(&ksm_mm_head.mm_list);
+	needs_wakeup = !ksm_nr_mm_slots;
 
-	spin_lock(&ksm_mmlist_lock);
+	worker = ksm_choose_worker();
 	insert_to_mm_slots_hash(mm, mm_slot);
+	mm_slot->worker = worker;
 	/*
 	 * Insert just behind the scanning cursor, to let the area settle
 	 * down a little; when fork is followed by immediate exec, we don't
 	 * want ksmd to waste time setting up and tearing down an rmap_list.
 	 */
-	list_add_tail(&mm_slot->mm_list, &ksm_scan.mm_slot->mm_list);
+	list_add_tail(&mm_slot->mm_list, &worker->scan.mm_slot->mm_list);
+	worker->nr_mm_slots++;
+	ksm_nr_mm_slots++;
 	spin_unlock(&ksm_mmlist_lock);
 
 	set_bit(MMF_VM_MERGEABLE, &mm->flags);
@@ -1542,14 +1775,16 @@ void __ksm_exit(struct mm_struct *mm)
 
 	spin_lock(&ksm_mmlist_lock);
 	mm_slot = get_mm_slot(mm);
-	if (mm_slot && ksm_scan.mm_slot != mm_slot) {
+	if (mm_slot && mm_slot->worker->scan.mm_slot != mm_slot) {
 		if (!mm_slot->rmap_list) {
 			hlist_del(&mm_slot->link);
 			list_del(&mm_slot->mm_list);
+			mm_slot->worker->nr_mm_slots--;
+			ksm_nr_mm_slots--;
 			easy_to_free = 1;
 		} else {
 			list_move(&mm_slot->mm_list,
-				  &ksm_scan.mm_slot->mm_list);
+				  &mm_slot->worker->scan.mm_slot->mm_list);
 		}
 	}
 	spin_unlock(&ksm_mmlist_lock);
@@ -1764,14 +1999,18 @@ static struct stable_node *ksm_check_stable_tree(unsigned long start_pfn,
 						 unsigned long end_pfn)
 {
 	struct rb_node *node;
+	int nid;
 
-	for (node = rb_first(&root_stable_tree); node; node = rb_next(node)) {
-		struct stable_node *stable_node;
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		for (node = rb_first(&ksm_trees[nid].stable); node;
+		     node = rb_next(node)) {
+			struct stable_node *stable_node;
 
-		stable_node = rb_entry(node, struct stable_node, node);
-		if (stable_node->kpfn >= start_pfn &&
-		    stable_node->kpfn < end_pfn)
-			return stable_node;
+			stable_node = rb_entry(node, struct stable_node, node);
+			if (stable_node->kpfn >= start_pfn &&
+			    stable_node->kpfn < end_pfn)
+				return stable_node;
+		}
 	}
 	return NULL;
 }
@@ -1787,13 +2026,13 @@ static int ksm_memory_callback(struct notifier_block *self,
 		/*
 		 * Keep it very simple for now: just lock out ksmd and
 		 * MADV_UNMERGEABLE while any memory is going offline.
-		 * mutex_lock_nested() is necessary because lockdep was alarmed
-		 * that here we take ksm_thread_mutex inside notifier chain
+		 * down_write_nested() is necessary because lockdep was alarmed
+		 * that here we take ksm_thread_sem inside notifier chain
 		 * mutex, and later take notifier chain mutex inside
-		 * ksm_thread_mutex to unlock it.   But that's safe because both
+		 * ksm_thread_sem to unlock it.   But that's safe because both
 		 * are inside mem_hotplug_mutex.
 		 */
-		mutex_lock_nested(&ksm_thread_mutex, SINGLE_DEPTH_NESTING);
+		down_write_nested(&ksm_thread_sem, SINGLE_DEPTH_NESTING);
 		break;
 
 	case MEM_OFFLINE:
@@ -1808,7 +2047,7 @@ static int ksm_memory_callback(struct notifier_block *self,
 		/* fallthrough */
 
 	case MEM_CANCEL_OFFLINE:
-		mutex_unlock(&ksm_thread_mutex);
+		up_write(&ksm_thread_sem);
 		break;
 	}
 	return NOTIFY_OK;
@@ -1897,7 +2136,7 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 	 * on the list for when ksmd may be set running again).
 	 */
 
-	mutex_lock(&ksm_thread_mutex);
+	down_write(&ksm_thread_sem);
 	if (ksm_run != flags) {
 		ksm_run = flags;
 		if (flags & KSM_RUN_UNMERGE) {
@@ -1912,7 +2151,7 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 			}
 		}
 	}
-	mutex_unlock(&ksm_thread_mutex);
+	up_write(&ksm_thread_sem);
 
 	if (flags & KSM_RUN_MERGE)
 		wake_up_interruptible(&ksm_thread_wait);
@@ -1921,24 +2160,69 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 }
 KSM_ATTR(run);
 
+#ifdef CONFIG_NUMA
+static ssize_t merge_across_nodes_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_merge_across_nodes);
+}
+
+static ssize_t merge_across_nodes_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	int err;
+	unsigned long knob;
+
+	err = strict_strtoul(buf, 10, &knob);
+	if (err)
+		return err;
+	if (knob > 1)
+		return -EINVAL;
+
+	/*
+	 * The stable trees cannot be rearranged while they hold ksm pages:
+	 * the user has to unmerge them all with run=2 before switching.
+	 */
+	down_write(&ksm_thread_sem);
+	if (ksm_merge_across_nodes != knob) {
+		if (atomic_long_read(&ksm_pages_shared))
+			err = -EBUSY;
+		else
+			ksm_merge_across_nodes = knob;
+	}
+	up_write(&ksm_thread_sem);
+
+	return err ? err : count;
+}
+KSM_ATTR(merge_across_nodes);
+#endif
+
+static ssize_t threads_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_nr_workers);
+}
+KSM_ATTR_RO(threads);
+
 static ssize_t pages_shared_show(struct kobject *kobj,
 				 struct kobj_attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", ksm_pages_shared);
+	return sprintf(buf, "%ld\n", atomic_long_read(&ksm_pages_shared));
 }
 KSM_ATTR_RO(pages_shared);
 
 static ssize_t pages_sharing_show(struct kobject *kobj,
 				  struct kobj_attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", ksm_pages_sharing);
+	return sprintf(buf, "%ld\n", atomic_long_read(&ksm_pages_sharing));
 }
 KSM_ATTR_RO(pages_sharing);
 
 static ssize_t pages_unshared_show(struct kobject *kobj,
 				   struct kobj_attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", ksm_pages_unshared);
+	return sprintf(buf, "%ld\n", atomic_long_read(&ksm_pages_unshared));
 }
 KSM_ATTR_RO(pages_unshared);
 
@@ -1947,8 +2231,10 @@ static ssize_t pages_volatile_show(struct kobject *kobj,
 {
 	long ksm_pages_volatile;
 
-	ksm_pages_volatile = ksm_rmap_items - ksm_pages_shared
-				- ksm_pages_sharing - ksm_pages_unshared;
+	ksm_pages_volatile = atomic_long_read(&ksm_rmap_items)
+				- atomic_long_read(&ksm_pages_shared)
+				- atomic_long_read(&ksm_pages_sharing)
+				- atomic_long_read(&ksm_pages_unshared);
 	/*
 	 * It was not worth any locking to calculate that statistic,
 	 * but it might therefore sometimes be negative: conceal that.
@@ -1962,7 +2248,7 @@ KSM_ATTR_RO(pages_volatile);
 static ssize_t full_scans_show(struct kobject *kobj,
 			       struct kobj_attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", ksm_scan.seqnr);
+	return sprintf(buf, "%lu\n", ksm_seqnr);
 }
 KSM_ATTR_RO(full_scans);
 
@@ -1970,6 +2256,10 @@ static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
 	&run_attr.attr,
+#ifdef CONFIG_NUMA
+	&merge_across_nodes_attr.attr,
+#endif
+	&threads_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
 	&pages_unshared_attr.attr,
@@ -1984,27 +2274,115 @@ static struct attribute_group ksm_attr_group = {
 };
 #endif /* CONFIG_SYSFS */
 
+static int __init setup_ksm_threads(char *str)
+{
+	unsigned long nr;
+
+	if (strict_strtoul(str, 0, &nr) || !nr || nr > UINT_MAX)
+		return 0;
+	ksm_nr_workers = nr;
+	return 1;
+}
+__setup("ksm_threads=", setup_ksm_threads);
+
+static int __init ksm_trees_init(void)
+{
+	int nid;
+
+	ksm_trees = kcalloc(nr_node_ids, sizeof(struct ksm_tree), GFP_KERNEL);
+	if (!ksm_trees)
+		return -ENOMEM;
+
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		ksm_trees[nid].stable = RB_ROOT;
+		ksm_trees[nid].unstable = RB_ROOT;
+		mutex_init(&ksm_trees[nid].mutex);
+	}
+	return 0;
+}
+
+/*
+ * Stop the first nr ksmd threads, which are all that were started, and
+ * tear down the workers so that nothing walks a stale ksm_workers array.
+ */
+static void __init ksm_stop_threads(unsigned int nr)
+{
+	while (nr--)
+		kthread_stop(ksm_workers[nr].task);
+	kfree(ksm_workers);
+	ksm_workers = NULL;
+	ksm_nr_workers = 0;
+}
+
+/*
+ * Start the ksmd threads, spread round-robin over the online nodes and
+ * bound to the cpus of their node.
+ */
+static int __init ksm_start_threads(void)
+{
+	struct ksm_worker *worker;
+	unsigned int i;
+	int nid;
+
+	if (!ksm_nr_workers)
+		ksm_nr_workers = num_online_nodes();
+	ksm_nr_workers = min(ksm_nr_workers, num_possible_cpus());
+
+	ksm_workers = kcalloc(ksm_nr_workers, sizeof(struct ksm_worker),
+			      GFP_KERNEL);
+	if (!ksm_workers) {
+		ksm_nr_workers = 0;
+		return -ENOMEM;
+	}
+
+	nid = first_online_node;
+	for (i = 0; i < ksm_nr_workers; i++) {
+		worker = &ksm_workers[i];
+		INIT_LIST_HEAD(&worker->mm_head.mm_list);
+		worker->scan.mm_slot = &worker->mm_head;
+		worker->nid = nid;
+		nid = next_online_node(nid);
+		if (nid == MAX_NUMNODES)
+			nid = first_online_node;
+	}
+
+	for (i = 0; i < ksm_nr_workers; i++) {
+		worker = &ksm_workers[i];
+		worker->task = kthread_create_on_node(ksm_scan_thread, worker,
+						worker->nid, "ksmd%u", i);
+		if (IS_ERR(worker->task)) {
+			int err = PTR_ERR(worker->task);
+
+			printk(KERN_ERR "ksm: creating kthread failed\n");
+			ksm_stop_threads(i);
+			return err;
+		}
+		wake_up_process(worker->task);
+	}
+	return 0;
+}
+
 static int __init ksm_init(void)
 {
-	struct task_struct *ksm_thread;
 	int err;
 
-	err = ksm_slab_init();
+	err = ksm_trees_init();
 	if (err)
 		goto out;
 
-	ksm_thread = kthread_run(ksm_scan_thread, NULL, "ksmd");
-	if (IS_ERR(ksm_thread)) {
-		printk(KERN_ERR "ksm: creating kthread failed\n");
-		err = PTR_ERR(ksm_thread);
+	err = ksm_slab_init();
+	if (err)
+		goto out_free_trees;
+
+	err = ksm_start_threads();
+	if (err)
 		goto out_free;
-	}
 
 #ifdef CONFIG_SYSFS
 	err = sysfs_create_group(mm_kobj, &ksm_attr_group);
 	if (err) {
 		printk(KERN_ERR "ksm: register sysfs failed\n");
-		kthread_stop(ksm_thread);
+		ksm_stop_threads(ksm_nr_workers);
 		goto out_free;
 	}
 #else
@@ -2014,7 +2392,7 @@ static int __init ksm_init(void)
 
 #ifdef CONFIG_MEMORY_HOTREMOVE
 	/*
-	 * Choose a high priority since the callback takes ksm_thread_mutex:
+	 * Choose a high priority since the callback takes ksm_thread_sem:
 	 * later callbacks could only be taking locks which nest within that.
 	 */
 	hotplug_memory_notifier(ksm_memory_callback, 100);
@@ -2023,6 +2401,8 @@ static int __init ksm_init(void)
 
 out_free:
 	ksm_slab_free();
+out_free_trees:
+	kfree(ksm_trees);
 out:
 	return err;
 }
@@ -57,6 +57,7 @@
 #include <linux/swapops.h>
 #include <linux/elf.h>
 #include <linux/gfp.h>
+#include <linux/userfaultfd_k.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -230,6 +231,7 @@ void tlb_gather_mmu(struct mmu_gather *tlb, struct mm_struct *mm, bool fullmm)
 
 	tlb->fullmm     = fullmm;
 	tlb->need_flush = 0;
+	__tlb_reset_range(tlb);
 	tlb->fast_mode  = (num_possible_cpus() == 1);
 	tlb->local.next = NULL;
 	tlb->local.nr   = 0;
@@ -249,6 +251,7 @@ void tlb_flush_mmu(struct mmu_gather *tlb)
 		return;
 	tlb->need_flush = 0;
 	tlb_flush(tlb);
+	__tlb_reset_range(tlb);
 #ifdef CONFIG_HAVE_RCU_TABLE_FREE
 	tlb_table_flush(tlb);
 #endif
@@ -1230,7 +1233,7 @@ static inline unsigned long zap_pmd_range(struct mmu_gather *tlb,
 			if (next-addr != HPAGE_PMD_SIZE) {
 				VM_BUG_ON(!rwsem_is_locked(&tlb->mm->mmap_sem));
 				split_huge_page_pmd(vma->vm_mm, pmd);
-			} else if (zap_huge_pmd(tlb, vma, pmd))
+			} else if (zap_huge_pmd(tlb, vma, pmd, addr))
 				continue;
 			/* fall through */
 		}
@@ -3041,6 +3044,11 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
 		if (!pte_none(*page_table))
 			goto unlock;
+		/* Deliver the page fault to userland, check inside PT lock */
+		if (userfaultfd_missing(vma)) {
+			pte_unmap_unlock(page_table, ptl);
+			return handle_userfault(vma, address, flags);
+		}
 		goto setpte;
 	}
 
@@ -3063,6 +3071,14 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	if (!pte_none(*page_table))
 		goto release;
 
+	/* Deliver the page fault to userland, check inside PT lock */
+	if (userfaultfd_missing(vma)) {
+		pte_unmap_unlock(page_table, ptl);
+		mem_cgroup_uncharge_page(page);
+		page_cache_release(page);
+		return handle_userfault(vma, address, flags);
+	}
+
 	inc_mm_counter_fast(mm, MM_ANONPAGES);
 	page_add_new_anon_rmap(page, vma, address);
 setpte:
@@ -3445,6 +3461,194 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	return handle_pte_fault(mm, vma, address, pte, pmd, flags);
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Take a consistent snapshot of vma into *copy and check that it is a
+ * vma the speculative path can handle for this fault.  Returns false if
+ * it is not, or if the vma is being changed under us.
+ */
+static bool spf_snapshot_vma(struct vm_area_struct *vma, unsigned long address,
+			     unsigned int flags, struct vm_area_struct *copy,
+			     unsigned int *seq)
+{
+	*seq = ACCESS_ONCE(vma->vm_sequence.sequence);
+	if (*seq & 1)
+		return false;
+	smp_rmb();
+	*copy = *vma;
+	if (read_seqcount_retry(&vma->vm_sequence, *seq))
+		return false;
+
+	if (address < copy->vm_start || address >= copy->vm_end)
+		return false;
+
+	/* Private anonymous memory only, with its anon_vma already set up */
+	if (copy->vm_ops || !copy->anon_vma || vma_policy(copy))
+		return false;
+	/* Missing pages of a userfaultfd range are filled by userland */
+	if (userfaultfd_armed(copy))
+		return false;
+	if (copy->vm_flags & (VM_SHARED | VM_LOCKED | VM_HUGETLB | VM_PFNMAP |
+			      VM_IO | VM_MIXEDMAP | VM_NONLINEAR))
+		return false;
+
+	/* The stack guard page needs mmap_sem, see check_stack_guard_page */
+	address &= PAGE_MASK;
+	if ((copy->vm_flags & VM_GROWSDOWN) && address == copy->vm_start)
+		return false;
+	if ((copy->vm_flags & VM_GROWSUP) && address + PAGE_SIZE == copy->vm_end)
+		return false;
+
+	if (flags & FAULT_FLAG_WRITE)
+		return copy->vm_flags & VM_WRITE;
+	return copy->vm_flags & (VM_READ | VM_EXEC | VM_WRITE);
+}
+
+/*
+ * Try to handle a fault on an empty pte of a private anonymous vma
+ * without taking mmap_sem.
+ *
+ * The vma is looked up under RCU and validated through vm_sequence.
+ * The page tables are walked with interrupts disabled, which holds off
+ * the TLB shootdown IPI that must complete before a page table can be
+ * freed, as in get_user_pages_fast().  For the same reason the pte lock
+ * is only trylocked: its holder may be waiting for us to take that IPI.
+ * Once we hold it, the vma is checked once more and then the pte is
+ * installed from the snapshot; anyone changing the vma after that point
+ * has to take the pte lock to change the pte, and sees ours.
+ *
+ * Returns 0 if the fault was handled, VM_FAULT_RETRY if the caller must
+ * go the classic way through handle_mm_fault() under mmap_sem.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags)
+{
+	struct vm_area_struct *vma, copy;
+	struct page *page = NULL;
+	unsigned int seq;
+	spinlock_t *ptl;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmdp, pmd;
+	pte_t *pte, entry;
+
+	check_sync_rss_stat(current);
+
+	/*
+	 * First see whether this is a fault we can handle at all, and
+	 * allocate the page while we are still allowed to sleep.
+	 */
+	rcu_read_lock();
+	vma = find_vma_rcu(mm, address);
+	if (!vma || !spf_snapshot_vma(vma, address, flags, &copy, &seq)) {
+		rcu_read_unlock();
+		goto out_retry;
+	}
+	rcu_read_unlock();
+
+	if (flags & FAULT_FLAG_WRITE) {
+		page = alloc_zeroed_user_highpage_movable(&copy, address);
+		if (!page)
+			goto out_retry;
+		__SetPageUptodate(page);
+
+		if (mem_cgroup_newpage_charge(page, mm, GFP_KERNEL)) {
+			page_cache_release(page);
+			goto out_retry;
+		}
+	}
+
+	local_irq_disable();
+	rcu_read_lock();
+	vma = find_vma_rcu(mm, address);
+	if (!vma || !spf_snapshot_vma(vma, address, flags, &copy, &seq))
+		goto out_abort;
+
+	pgd = pgd_offset(mm, address);
+	if (!pgd_present(*pgd))
+		goto out_abort;
+	pud = pud_offset(pgd, address);
+	if (!pud_present(*pud))
+		goto out_abort;
+	pmdp = pmd_offset(pud, address);
+	pmd = *pmdp;
+	barrier();
+	/* Page table allocation and huge pmds are left to the classic path */
+	if (pmd_none(pmd) || pmd_trans_huge(pmd) || unlikely(pmd_bad(pmd)))
+		goto out_abort;
+
+	ptl = pte_lockptr(mm, &pmd);
+	pte = pte_offset_map(&pmd, address);
+	if (!spin_trylock(ptl)) {
+		pte_unmap(pte);
+		goto out_abort;
+	}
+	if (!pmd_same(*pmdp, pmd) ||
+	    read_seqcount_retry(&vma->vm_sequence, seq)) {
+		pte_unmap_unlock(pte, ptl);
+		goto out_abort;
+	}
+	if (!pte_none(*pte)) {
+		/* Somebody else populated it: just go back and retry */
+		pte_unmap_unlock(pte, ptl);
+		rcu_read_unlock();
+		local_irq_enable();
+		if (page) {
+			mem_cgroup_uncharge_page(page);
+			page_cache_release(page);
+		}
+		return 0;
+	}
+
+	if (page) {
+		entry = mk_pte(page, copy.vm_page_prot);
+		entry = pte_mkwrite(pte_mkdirty(entry));
+		inc_mm_counter_fast(mm, MM_ANONPAGES);
+		__page_add_new_anon_rmap(page, &copy, address);
+		/* Keep the page around until it is on the LRU, see below */
+		page_cache_get(page);
+	} else
+		entry = pte_mkspecial(pfn_pte(my_zero_pfn(address),
+					      copy.vm_page_prot));
+	set_pte_at(mm, address, pte, entry);
+
+	/* No need to invalidate - it was non-present before */
+	update_mmu_cache(&copy, address, pte);
+	pte_unmap_unlock(pte, ptl);
+	rcu_read_unlock();
+	local_irq_enable();
+
+	/*
+	 * Adding to the LRU may take zone->lru_lock with spin_lock_irq(),
+	 * so it could not be done with interrupts disabled above.  The
+	 * pte may be zapped again by now, hence the extra reference.
+	 */
+	if (page) {
+		if (page_evictable(page, &copy))
+			lru_cache_add_lru(page, LRU_ACTIVE_ANON);
+		else
+			add_page_to_unevictable_list(page);
+		page_cache_release(page);
+	}
+
+	count_vm_event(PGFAULT);
+	mem_cgroup_count_vm_event(mm, PGFAULT);
+	count_vm_event(SPECULATIVE_PGFAULT);
+	return 0;
+
+out_abort:
+	rcu_read_unlock();
+	local_irq_enable();
+	if (page) {
+		mem_cgroup_uncharge_page(page);
+		page_cache_release(page);
+	}
+out_retry:
+	count_vm_event(SPECULATIVE_PGFAULT_ABORT);
+	return VM_FAULT_RETRY;
+}
+#endif /* CONFIG_SPECULATIVE_PAGE_FAULT */
+
 #ifndef __PAGETABLE_PUD_FOLDED
 /*
  * Allocate page upper directory.
@@ -34,6 +34,7 @@
 #include <linux/syscalls.h>
 #include <linux/hugetlb.h>
 #include <linux/gfp.h>
+#include <linux/page_idle.h>
 
 #include <asm/tlbflush.h>
 
@@ -368,6 +369,15 @@ void migrate_page_copy(struct page *newpage, struct page *page)
 	if (PageMappedToDisk(page))
 		SetPageMappedToDisk(newpage);
 
+	/*
+	 * Copy the idle page tracking state, so that the migration
+	 * is invisible to whoever is estimating the working set.
+	 */
+	if (page_is_young(page))
+		set_page_young(newpage);
+	if (page_is_idle(page))
+		set_page_idle(newpage);
+
 	if (PageDirty(page)) {
 		clear_page_dirty_for_io(page);
 		/*
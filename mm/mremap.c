@@ -41,8 +41,7 @@ static pmd_t *get_old_pmd(struct mm_struct *mm, unsigned long addr)
 		return NULL;
 
 	pmd = pmd_offset(pud, addr);
-	split_huge_page_pmd(mm, pmd);
-	if (pmd_none_or_clear_bad(pmd))
+	if (pmd_none(*pmd))
 		return NULL;
 
 	return pmd;
@@ -65,8 +64,6 @@ static pmd_t *alloc_new_pmd(struct mm_struct *mm, struct vm_area_struct *vma,
 		return NULL;
 
 	VM_BUG_ON(pmd_trans_huge(*pmd));
-	if (pmd_none(*pmd) && __pte_alloc(mm, vma, pmd, addr))
-		return NULL;
 
 	return pmd;
 }
@@ -81,10 +78,9 @@ static void move_ptes(struct vm_area_struct *vma, pmd_t *old_pmd,
 	pte_t *old_pte, *new_pte, pte;
 	spinlock_t *old_ptl, *new_ptl;
 	unsigned long old_start;
+	bool need_flush = false;
 
 	old_start = old_addr;
-	mmu_notifier_invalidate_range_start(vma->vm_mm,
-					    old_start, old_end);
 	if (vma->vm_file) {
 		/*
 		 * Subtle point from Rajesh Venkatasubramanian: before
@@ -111,21 +107,100 @@ static void move_ptes(struct vm_area_struct *vma, pmd_t *old_pmd,
 				   new_pte++, new_addr += PAGE_SIZE) {
 		if (pte_none(*old_pte))
 			continue;
-		pte = ptep_clear_flush(vma, old_addr, old_pte);
+		pte = ptep_get_and_clear(mm, old_addr, old_pte);
 		pte = move_pte(pte, new_vma->vm_page_prot, old_addr, new_addr);
 		set_pte_at(mm, new_addr, new_pte, pte);
+		need_flush = true;
 	}
 
 	arch_leave_lazy_mmu_mode();
+	/*
+	 * Flush the old range once for the whole extent, but before the
+	 * pte locks are dropped: otherwise rmap could unmap or clean the
+	 * page at its new address while a stale TLB entry still lets
+	 * another CPU write to it through the old one.
+	 */
+	if (need_flush)
+		flush_tlb_range(vma, old_start, old_end);
 	if (new_ptl != old_ptl)
 		spin_unlock(new_ptl);
 	pte_unmap(new_pte - 1);
 	pte_unmap_unlock(old_pte - 1, old_ptl);
 	if (mapping)
 		mutex_unlock(&mapping->i_mmap_mutex);
-	mmu_notifier_invalidate_range_end(vma->vm_mm, old_start, old_end);
 }
 
+#ifdef CONFIG_HAVE_MOVE_PMD
+/*
+ * Move a whole page table from old_pmd to new_pmd, instead of moving
+ * its ptes one by one, when both addresses are PMD aligned and the
+ * range covers the full table.  Returns true if the table was moved.
+ */
+static bool move_normal_pmd(struct vm_area_struct *vma, pmd_t *old_pmd,
+		unsigned long old_addr, unsigned long old_end,
+		pmd_t *new_pmd, unsigned long new_addr)
+{
+	struct address_space *mapping = NULL;
+	struct mm_struct *mm = vma->vm_mm;
+	spinlock_t *old_ptl;
+	pmd_t pmd;
+
+	if ((old_addr & ~PMD_MASK) || (new_addr & ~PMD_MASK) ||
+	    old_end - old_addr < PMD_SIZE)
+		return false;
+
+	/*
+	 * The destination pmd shouldn't be established, free_pgtables()
+	 * should have released it.
+	 */
+	if (WARN_ON(!pmd_none(*new_pmd)))
+		return false;
+
+	/*
+	 * Unlike move_ptes(), the ptes keep living in the same page, so
+	 * rmap walkers that looked up the table through the old pmd must
+	 * be kept out for anon pages as well as for file pages.
+	 */
+	if (vma->vm_file) {
+		mapping = vma->vm_file->f_mapping;
+		mutex_lock(&mapping->i_mmap_mutex);
+	}
+	vma_lock_anon_vma(vma);
+
+	/*
+	 * The pte lock lives with the page table and moves along with
+	 * it; page_table_lock serializes against __pte_alloc().
+	 */
+	spin_lock(&mm->page_table_lock);
+	old_ptl = pte_lockptr(mm, old_pmd);
+	if (old_ptl != &mm->page_table_lock)
+		spin_lock(old_ptl);
+
+	pmd = *old_pmd;
+	pmd_clear(old_pmd);
+	VM_BUG_ON(!pmd_none(*new_pmd));
+	set_pmd(new_pmd, pmd);
+	flush_tlb_range(vma, old_addr, old_addr + PMD_SIZE);
+
+	if (old_ptl != &mm->page_table_lock)
+		spin_unlock(old_ptl);
+	spin_unlock(&mm->page_table_lock);
+
+	vma_unlock_anon_vma(vma);
+	if (mapping)
+		mutex_unlock(&mapping->i_mmap_mutex);
+
+	return true;
+}
+#else
+static inline bool move_normal_pmd(struct vm_area_struct *vma,
+		pmd_t *old_pmd, unsigned long old_addr, unsigned long old_end,
+		pmd_t *new_pmd, unsigned long new_addr)
+{
+	return false;
+}
+#endif
+
 #define LATENCY_LIMIT	(64 * PAGE_SIZE)
 
 unsigned long move_page_tables(struct vm_area_struct *vma,
@@ -138,6 +213,8 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 	old_end = old_addr + len;
 	flush_cache_range(vma, old_addr, old_end);
 
+	mmu_notifier_invalidate_range_start(vma->vm_mm, old_addr, old_end);
+
 	for (; old_addr < old_end; old_addr += extent, new_addr += extent) {
 		cond_resched();
 		next = (old_addr + PMD_SIZE) & PMD_MASK;
@@ -150,6 +227,28 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 		new_pmd = alloc_new_pmd(vma->vm_mm, vma, new_addr);
 		if (!new_pmd)
 			break;
+		if (pmd_trans_huge(*old_pmd)) {
+			int err = 0;
+			if (extent == HPAGE_PMD_SIZE)
+				err = move_huge_pmd(vma, new_vma, old_addr,
+						    new_addr, old_end,
+						    old_pmd, new_pmd);
+			if (err > 0)
+				continue;
+			else if (!err)
+				split_huge_page_pmd(vma->vm_mm, old_pmd);
+			VM_BUG_ON(pmd_trans_huge(*old_pmd));
+		} else if (pmd_bad(*old_pmd)) {
+			pmd_clear_bad(old_pmd);
+			continue;
+		} else if (extent == PMD_SIZE &&
+			   move_normal_pmd(vma, old_pmd, old_addr, old_end,
+					   new_pmd, new_addr)) {
+			continue;
+		}
+		if (pmd_none(*new_pmd) &&
+		    __pte_alloc(new_vma->vm_mm, new_vma, new_pmd, new_addr))
+			break;
 		next = (new_addr + PMD_SIZE) & PMD_MASK;
 		if (extent > next - new_addr)
 			extent = next - new_addr;
@@ -159,6 +258,8 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 				new_vma, new_pmd, new_addr);
 	}
 
+	mmu_notifier_invalidate_range_end(vma->vm_mm, old_end - len, old_end);
+
 	return len + old_addr - old_end;	/* how much done */
 }
 
@@ -200,6 +301,12 @@ static unsigned long move_vma(struct vm_area_struct *vma,
 	if (!new_vma)
 		return -ENOMEM;
 
+	/*
+	 * copy_vma() left new_vma write-locked against speculative faults:
+	 * hold the source off too until its ptes have all gone across.
+	 */
+	if (vma != new_vma)
+		vm_write_begin(vma);
 	moved_len = move_page_tables(vma, old_addr, new_vma, new_addr, old_len);
 	if (moved_len < old_len) {
 		/*
@@ -208,6 +315,12 @@ static unsigned long move_vma(struct vm_area_struct *vma,
 		 * and then proceed to unmap new area instead of old.
 		 */
 		move_page_tables(new_vma, new_addr, vma, old_addr, moved_len);
+	}
+	if (vma != new_vma)
+		vm_write_end(vma);
+	vm_write_end(new_vma);
+
+	if (moved_len < old_len) {
 		vma = new_vma;
 		old_len = new_len;
 		old_addr = new_addr;
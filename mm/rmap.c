@@ -57,6 +57,7 @@
 #include <linux/mmu_notifier.h>
 #include <linux/migrate.h>
 #include <linux/hugetlb.h>
+#include <linux/page_idle.h>
 
 #include <asm/tlbflush.h>
 
@@ -678,8 +679,10 @@ int page_referenced_one(struct page *page, struct vm_area_struct *vma,
 		}
 
 		/* go ahead even if the pmd is pmd_trans_splitting() */
-		if (pmdp_clear_flush_young_notify(vma, address, pmd))
+		if (pmdp_clear_flush_young_notify(vma, address, pmd)) {
+			clear_page_idle(page);
 			referenced++;
+		}
 		spin_unlock(&mm->page_table_lock);
 	} else {
 		pte_t *pte;
@@ -701,6 +704,11 @@ int page_referenced_one(struct page *page, struct vm_area_struct *vma,
 		}
 
 		if (ptep_clear_flush_young_notify(vma, address, pte)) {
+			/*
+			 * The page was accessed through this mapping: it
+			 * is no longer idle, whatever reclaim makes of it.
+			 */
+			clear_page_idle(page);
 			/*
 			 * Don't treat a reference through a sequentially read
 			 * mapping as such.  If the page has been used in
@@ -714,6 +722,13 @@ int page_referenced_one(struct page *page, struct vm_area_struct *vma,
 		pte_unmap_unlock(pte, ptl);
 	}
 
+	/*
+	 * Idle page tracking may have cleared the young bits behind our
+	 * back; it leaves PG_young set so that reclaim still sees them.
+	 */
+	if (test_and_clear_page_young(page))
+		referenced++;
+
 	/* Pretend the page is referenced if the task has the
 	   swap token and is in the middle of a page fault. */
 	if (mm != current->mm && has_swap_token(mm) &&
@@ -1072,6 +1087,24 @@ void do_page_add_anon_rmap(struct page *page,
 		__page_check_anon_rmap(page, vma, address);
 }
 
+/*
+ * The part of page_add_new_anon_rmap that does not put the page on the
+ * LRU, for the speculative fault path which has interrupts disabled
+ * under the pte lock and adds the page to the LRU after dropping it.
+ */
+void __page_add_new_anon_rmap(struct page *page,
+	struct vm_area_struct *vma, unsigned long address)
+{
+	VM_BUG_ON(address < vma->vm_start || address >= vma->vm_end);
+	SetPageSwapBacked(page);
+	atomic_set(&page->_mapcount, 0); /* increment count (starts at -1) */
+	if (!PageTransHuge(page))
+		__inc_zone_page_state(page, NR_ANON_PAGES);
+	else
+		__inc_zone_page_state(page, NR_ANON_TRANSPARENT_HUGEPAGES);
+	__page_set_anon_rmap(page, vma, address, 1);
+}
+
 /**
  * page_add_new_anon_rmap - add pte mapping to a new anonymous page
  * @page:	the page to add the mapping to
@@ -1085,14 +1118,7 @@ void do_page_add_anon_rmap(struct page *page,
 void page_add_new_anon_rmap(struct page *page,
 	struct vm_area_struct *vma, unsigned long address)
 {
-	VM_BUG_ON(address < vma->vm_start || address >= vma->vm_end);
-	SetPageSwapBacked(page);
-	atomic_set(&page->_mapcount, 0); /* increment count (starts at -1) */
-	if (!PageTransHuge(page))
-		__inc_zone_page_state(page, NR_ANON_PAGES);
-	else
-		__inc_zone_page_state(page, NR_ANON_TRANSPARENT_HUGEPAGES);
-	__page_set_anon_rmap(page, vma, address, 1);
+	__page_add_new_anon_rmap(page, vma, address);
 	if (page_evictable(page, vma))
 		lru_cache_add_lru(page, LRU_ACTIVE_ANON);
 	else
@@ -43,6 +43,9 @@
 #include <linux/sysctl.h>
 #include <linux/oom.h>
 #include <linux/prefetch.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/memory.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -479,9 +482,11 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
- * gets returned with a refcount of 0.
+ * gets returned with a refcount of 0.  If @reclaimed is set, the page is
+ * being evicted by reclaim and leaves a shadow entry behind.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+static int __remove_mapping(struct address_space *mapping, struct page *page,
+			    bool reclaimed)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
@@ -531,6 +536,8 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		freepage = mapping->a_ops->freepage;
 
 		__delete_from_page_cache(page);
+		if (reclaimed && page_is_file_cache(page))
+			workingset_eviction(mapping, page);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
 
@@ -553,7 +560,7 @@ cannot_free:
  */
 int remove_mapping(struct address_space *mapping, struct page *page)
 {
-	if (__remove_mapping(mapping, page)) {
+	if (__remove_mapping(mapping, page, false)) {
 		/*
 		 * Unfreezing the refcount with 1 rather than 2 effectively
 		 * drops the pagecache ref for us without requiring another
@@ -901,7 +908,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping || !__remove_mapping(mapping, page, true))
 			goto keep_locked;
 
 		/*
@@ -1008,6 +1015,7 @@ int __isolate_lru_page(struct page *page, int mode, int file)
 		 * page release code relies on it.
 		 */
 		ClearPageLRU(page);
+		lru_gen_del_page(page_zone(page), page);
 		ret = 0;
 	}
 
@@ -1111,7 +1119,7 @@ static unsigned long isolate_lru_pages(unsigned long nr_to_scan,
 			 * anon page which don't already have a swap slot is
 			 * pointless.
 			 */
-			if (nr_swap_pages <= 0 && PageAnon(cursor_page) &&
+			if (get_nr_swap_pages() <= 0 && PageAnon(cursor_page) &&
 			    !PageSwapCache(cursor_page))
 				break;
 
@@ -1513,7 +1521,7 @@ static void move_active_pages_to_lru(struct zone *zone,
 		VM_BUG_ON(PageLRU(page));
 		SetPageLRU(page);
 
-		list_move(&page->lru, &zone->lru[lru].list);
+		list_move(&page->lru, lru_list_head(zone, page, lru));
 		mem_cgroup_add_lru_list(page, lru);
 		pgmoved += hpage_nr_pages(page);
 
@@ -1677,9 +1685,27 @@ static int inactive_file_is_low_global(struct zone *zone)
 	active = zone_page_state(zone, NR_ACTIVE_FILE);
 	inactive = zone_page_state(zone, NR_INACTIVE_FILE);
 
+	/*
+	 * Refaulting pages that got activated since the last reclaim
+	 * cycle mean a new working set is being established.  Keep
+	 * aging the active list so the part of the old working set that
+	 * is no longer used makes room for it.
+	 */
+	if (zone_page_state(zone, WORKINGSET_ACTIVATE) != zone->refaults)
+		return active > 0;
+
 	return (active > inactive);
 }
 
+/*
+ * Remember the refault activations as of the end of this reclaim
+ * cycle, see inactive_file_is_low_global().
+ */
+static void snapshot_refaults(struct zone *zone)
+{
+	zone->refaults = zone_page_state(zone, WORKINGSET_ACTIVATE);
+}
+
 /**
  * inactive_file_is_low - check if file pages need to be deactivated
  * @zone: zone to check
@@ -1690,7 +1716,8 @@ static int inactive_file_is_low_global(struct zone *zone)
  * than half of the file pages are on the inactive list.
  *
  * Once we get to that situation, protect the system's working
- * set from being evicted by disabling active file page aging.
+ * set from being evicted by disabling active file page aging,
+ * unless refaults show that the working set is changing.
  *
  * This uses a different ratio than the anonymous pages, because
  * the page cache uses a use-once replacement algorithm.
@@ -1765,7 +1792,7 @@ static void get_scan_count(struct zone *zone, struct scan_control *sc,
 	}
 
 	/* If we have no swap space, do not bother scanning anon pages. */
-	if (!sc->may_swap || (nr_swap_pages <= 0)) {
+	if (!sc->may_swap || (get_nr_swap_pages() <= 0)) {
 		noswap = 1;
 		fraction[0] = 0;
 		fraction[1] = 1;
@@ -1922,6 +1949,815 @@ static inline bool should_continue_reclaim(struct zone *zone,
 	}
 }
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * The multi-generational LRU.
+ *
+ * Evictable pages are kept on generation lists, see struct lru_gen_struct.
+ * Eviction takes pages from the oldest generation; aging creates a new
+ * youngest generation and moves the pages found accessed into it. Instead
+ * of walking the rmap of every candidate page, kswapd finds the accessed
+ * pages by scanning the page tables of all mm's in bulk, which costs much
+ * less CPU for large, densely mapped anonymous memory. The rmap is still
+ * checked for the few pages that are actually picked for eviction.
+ *
+ * Page table walks only record the new generation in page->flags; pages
+ * are moved to the matching list lazily, when eviction finds them on the
+ * list of the oldest generation.
+ */
+bool lru_gen_enabled_flag __read_mostly;
+
+#ifdef CONFIG_LRU_GEN_ENABLED
+static bool lru_gen_boot_state __initdata = true;
+#else
+static bool lru_gen_boot_state __initdata;
+#endif
+
+static DEFINE_MUTEX(lru_gen_state_mutex);
+
+/* All mm's whose page tables may be walked, protected by lru_gen_mm_lock */
+static LIST_HEAD(lru_gen_mm_list);
+static DEFINE_SPINLOCK(lru_gen_mm_lock);
+static unsigned long lru_gen_nr_mms;
+
+/* How many pages to move between lists before dropping zone->lru_lock */
+#define LRU_GEN_BATCH		1024
+
+void lru_gen_init_mm(struct mm_struct *mm)
+{
+	INIT_LIST_HEAD(&mm->lru_gen_list);
+}
+
+/*
+ * Only an mm which is fully set up, by dup_mm() or exec_mmap(), goes on
+ * the list: the failure paths before that free it without mmput().
+ */
+void lru_gen_add_mm(struct mm_struct *mm)
+{
+	spin_lock(&lru_gen_mm_lock);
+	list_add_tail(&mm->lru_gen_list, &lru_gen_mm_list);
+	lru_gen_nr_mms++;
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+void lru_gen_del_mm(struct mm_struct *mm)
+{
+	spin_lock(&lru_gen_mm_lock);
+	if (!list_empty(&mm->lru_gen_list)) {
+		list_del_init(&mm->lru_gen_list);
+		lru_gen_nr_mms--;
+	}
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+void lru_gen_init_zone(struct zone *zone)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	int gen, type;
+
+	memset(lrugen, 0, sizeof(*lrugen));
+	for (gen = 0; gen < MAX_NR_GENS; gen++)
+		for (type = 0; type < 2; type++)
+			INIT_LIST_HEAD(&lrugen->lists[gen][type]);
+
+	lrugen->max_seq = MIN_NR_GENS - 1;
+}
+
+static int lru_gen_nr_gens(struct lru_gen_struct *lrugen, int type)
+{
+	return lrugen->max_seq - lrugen->min_seq[type] + 1;
+}
+
+/* Is there a generation of @type older than the protected ones? */
+static bool lru_gen_has_old(struct lru_gen_struct *lrugen, int type)
+{
+	return lru_gen_nr_gens(lrugen, type) > MIN_NR_GENS;
+}
+
+/* Retire the oldest generations of @type that have become empty */
+static void try_to_inc_min_seq(struct zone *zone, int type)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+
+	while (lru_gen_has_old(lrugen, type)) {
+		int gen = lru_gen_from_seq(lrugen->min_seq[type]);
+
+		if (!list_empty(&lrugen->lists[gen][type]))
+			break;
+		lrugen->min_seq[type]++;
+	}
+}
+
+/* Fold the oldest generation of @type into the next one */
+static void inc_min_seq(struct zone *zone, int type)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	int old_gen = lru_gen_from_seq(lrugen->min_seq[type]);
+	int new_gen = lru_gen_from_seq(lrugen->min_seq[type] + 1);
+	struct list_head *head = &lrugen->lists[old_gen][type];
+
+	/* From the youngest to the oldest page, to preserve their order */
+	while (!list_empty(head)) {
+		struct page *page = list_first_entry(head, struct page, lru);
+		int gen = page_lru_gen(page);
+
+		VM_BUG_ON(gen < 0);
+		if (gen == old_gen) {
+			page_set_lru_gen(page, new_gen);
+			lru_gen_update_size(zone, page, old_gen,
+					    -hpage_nr_pages(page));
+			lru_gen_update_size(zone, page, new_gen,
+					    hpage_nr_pages(page));
+			list_move_tail(&page->lru,
+				       &lrugen->lists[new_gen][type]);
+		} else
+			list_move(&page->lru, &lrugen->lists[gen][type]);
+	}
+	lrugen->min_seq[type]++;
+}
+
+/* Open a new youngest generation, making room for it if necessary */
+static void inc_max_seq(struct zone *zone)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	int type;
+
+	spin_lock_irq(&zone->lru_lock);
+	if (!lrugen->enabled)
+		goto out;
+
+	for (type = 0; type < 2; type++) {
+		try_to_inc_min_seq(zone, type);
+		if (lru_gen_nr_gens(lrugen, type) == MAX_NR_GENS)
+			inc_min_seq(zone, type);
+	}
+
+	lrugen->max_seq++;
+	lrugen->timestamps[lru_gen_from_seq(lrugen->max_seq)] = jiffies;
+out:
+	spin_unlock_irq(&zone->lru_lock);
+}
+
+struct lru_gen_mm_walk {
+	int nid;
+	struct vm_area_struct *vma;
+	/* the youngest generation of each zone of the node */
+	unsigned long max_seq[MAX_NR_ZONES];
+	/* generation size changes not yet applied to the zones */
+	long nr_pages[MAX_NR_ZONES][MAX_NR_GENS][2];
+};
+
+/*
+ * Moves @page, found accessed through a page table, to the youngest
+ * generation. Returns false if the page belongs to another node, whose
+ * accessed bits are left alone.
+ */
+static bool lru_gen_walk_page(struct lru_gen_mm_walk *walk, struct page *page)
+{
+	int zid = page_zonenum(page);
+	int type = page_is_file_cache(page);
+	int new_gen, old_gen;
+	unsigned long old_flags, new_flags;
+
+	if (page_to_nid(page) != walk->nid)
+		return false;
+
+	new_gen = lru_gen_from_seq(walk->max_seq[zid]);
+	do {
+		old_flags = ACCESS_ONCE(page->flags);
+		old_gen = (int)((old_flags & LRU_GEN_MASK) >> LRU_GEN_PGOFF) - 1;
+		if (old_gen < 0) {
+			/* Isolated: leave the reference to shrink_page_list() */
+			new_flags = old_flags | (1UL << PG_referenced);
+		} else {
+			new_flags = (old_flags & ~LRU_GEN_MASK) |
+				    ((new_gen + 1UL) << LRU_GEN_PGOFF);
+		}
+		if (new_flags == old_flags)
+			return true;
+	} while (cmpxchg(&page->flags, old_flags, new_flags) != old_flags);
+
+	if (old_gen >= 0) {
+		walk->nr_pages[zid][old_gen][type] -= hpage_nr_pages(page);
+		walk->nr_pages[zid][new_gen][type] += hpage_nr_pages(page);
+	}
+	return true;
+}
+
+static int lru_gen_walk_pmd_range(pmd_t *pmd, unsigned long addr,
+				  unsigned long end, struct mm_walk *mm_walk)
+{
+	struct lru_gen_mm_walk *walk = mm_walk->private;
+	struct vm_area_struct *vma = walk->vma;
+	pte_t *pte, *orig_pte;
+	spinlock_t *ptl;
+
+	spin_lock(&mm_walk->mm->page_table_lock);
+	if (pmd_trans_huge(*pmd)) {
+		if (pmd_trans_splitting(*pmd)) {
+			spin_unlock(&mm_walk->mm->page_table_lock);
+			wait_split_huge_page(vma->anon_vma, pmd);
+		} else {
+			if (pmd_young(*pmd) &&
+			    page_to_nid(pmd_page(*pmd)) == walk->nid &&
+			    pmdp_test_and_clear_young(vma, addr, pmd))
+				lru_gen_walk_page(walk, pmd_page(*pmd));
+			spin_unlock(&mm_walk->mm->page_table_lock);
+			return 0;
+		}
+	} else {
+		spin_unlock(&mm_walk->mm->page_table_lock);
+	}
+	if (pmd_trans_huge(*pmd))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		struct page *page;
+
+		if (!pte_present(*pte) || !pte_young(*pte))
+			continue;
+
+		page = vm_normal_page(vma, addr, *pte);
+		if (!page || page_to_nid(page) != walk->nid)
+			continue;
+
+		if (ptep_test_and_clear_young(vma, addr, pte))
+			lru_gen_walk_page(walk, page);
+	}
+	pte_unmap_unlock(orig_pte, ptl);
+	cond_resched();
+	return 0;
+}
+
+/* Apply the generation size changes found by the walk to the zones */
+static void lru_gen_flush_walk(struct lru_gen_mm_walk *walk)
+{
+	pg_data_t *pgdat = NODE_DATA(walk->nid);
+	int zid, gen, type;
+
+	for (zid = 0; zid < MAX_NR_ZONES; zid++) {
+		struct zone *zone = pgdat->node_zones + zid;
+		long delta = 0;
+
+		for (gen = 0; gen < MAX_NR_GENS; gen++)
+			for (type = 0; type < 2; type++)
+				delta |= walk->nr_pages[zid][gen][type];
+		if (!delta)
+			continue;
+
+		spin_lock_irq(&zone->lru_lock);
+		for (gen = 0; gen < MAX_NR_GENS; gen++) {
+			for (type = 0; type < 2; type++) {
+				zone->lrugen.nr_pages[gen][type] +=
+					walk->nr_pages[zid][gen][type];
+				walk->nr_pages[zid][gen][type] = 0;
+			}
+		}
+		spin_unlock_irq(&zone->lru_lock);
+	}
+}
+
+static void lru_gen_walk_mm(struct lru_gen_mm_walk *walk, struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	struct mm_walk mm_walk = {
+		.pmd_entry = lru_gen_walk_pmd_range,
+		.mm = mm,
+		.private = walk,
+	};
+
+	if (!down_read_trylock(&mm->mmap_sem))
+		return;
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_flags & (VM_LOCKED | VM_IO | VM_PFNMAP))
+			continue;
+		if (is_vm_hugetlb_page(vma))
+			continue;
+
+		walk->vma = vma;
+		walk_page_range(vma->vm_start, vma->vm_end, &mm_walk);
+	}
+	up_read(&mm->mmap_sem);
+
+	lru_gen_flush_walk(walk);
+}
+
+/*
+ * Walks the page tables of every mm once. Each mm is rotated to the tail
+ * of the list as it is picked, so that the list can change under us.
+ */
+static void lru_gen_walk_mms(struct lru_gen_mm_walk *walk)
+{
+	unsigned long nr_mms;
+
+	spin_lock(&lru_gen_mm_lock);
+	nr_mms = lru_gen_nr_mms;
+	spin_unlock(&lru_gen_mm_lock);
+
+	while (nr_mms--) {
+		struct mm_struct *mm = NULL;
+
+		spin_lock(&lru_gen_mm_lock);
+		if (!list_empty(&lru_gen_mm_list)) {
+			mm = list_first_entry(&lru_gen_mm_list,
+					      struct mm_struct, lru_gen_list);
+			list_move_tail(&mm->lru_gen_list, &lru_gen_mm_list);
+			if (!atomic_inc_not_zero(&mm->mm_users))
+				mm = NULL;
+		}
+		spin_unlock(&lru_gen_mm_lock);
+
+		if (mm) {
+			lru_gen_walk_mm(walk, mm);
+			mmput(mm);
+		}
+		cond_resched();
+	}
+}
+
+/*
+ * Ages all the zones of a node by one generation. Only kswapd scans the
+ * page tables: it might end up dropping the last reference to an mm, and
+ * direct reclaimers can hold filesystem locks that exit_mmap() may need.
+ * Otherwise, the pages just get older and shrink_page_list() checks their
+ * references through the rmap when they are picked for eviction.
+ */
+static void lru_gen_age_node(pg_data_t *pgdat)
+{
+	struct lru_gen_mm_walk *walk = NULL;
+	int zid;
+
+	if (test_and_set_bit_lock(0, &pgdat->lru_gen_aging))
+		return;
+
+	if (current_is_kswapd())
+		walk = kzalloc(sizeof(*walk), GFP_NOWAIT | __GFP_NOWARN);
+
+	for (zid = 0; zid < MAX_NR_ZONES; zid++) {
+		struct zone *zone = pgdat->node_zones + zid;
+
+		if (!populated_zone(zone))
+			continue;
+
+		inc_max_seq(zone);
+		if (walk)
+			walk->max_seq[zid] = zone->lrugen.max_seq;
+	}
+
+	if (walk) {
+		walk->nid = pgdat->node_id;
+		lru_gen_walk_mms(walk);
+		kfree(walk);
+	}
+
+	clear_bit_unlock(0, &pgdat->lru_gen_aging);
+}
+
+/*
+ * Picks the type to evict from, or returns -1 if neither type has a
+ * generation old enough and the node needs to be aged first.
+ */
+static int lru_gen_pick_type(struct zone *zone, struct scan_control *sc,
+			     bool can_swap)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	bool has_anon = can_swap && lru_gen_has_old(lrugen, 0);
+	bool has_file = lru_gen_has_old(lrugen, 1);
+
+	if (has_anon && has_file) {
+		long anon, file;
+
+		anon = lrugen->nr_pages[lru_gen_from_seq(lrugen->min_seq[0])][0];
+		file = lrugen->nr_pages[lru_gen_from_seq(lrugen->min_seq[1])][1];
+
+		/* Balance the oldest generations according to swappiness */
+		return max(anon, 0L) * sc->swappiness >
+		       max(file, 0L) * (200 - sc->swappiness) ? 0 : 1;
+	}
+	if (has_file)
+		return 1;
+	if (has_anon)
+		return 0;
+	return -1;
+}
+
+/*
+ * Isolates pages from the tail of the oldest generation of @type. Pages
+ * that a page table walk has moved to a younger generation are put on
+ * their list on the way.
+ */
+static unsigned long lru_gen_isolate_pages(struct zone *zone, int type,
+					   unsigned long nr_to_scan,
+					   struct list_head *dst,
+					   unsigned long *scanned)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	int gen = lru_gen_from_seq(lrugen->min_seq[type]);
+	struct list_head *src = &lrugen->lists[gen][type];
+	unsigned long nr_taken = 0;
+	unsigned long scan;
+
+	for (scan = 0; scan < nr_to_scan && !list_empty(src); scan++) {
+		struct page *page = lru_to_page(src);
+		int page_gen = page_lru_gen(page);
+
+		prefetchw_prev_lru_page(page, src, flags);
+
+		VM_BUG_ON(!PageLRU(page));
+		VM_BUG_ON(page_gen < 0);
+
+		if (page_gen != gen) {
+			list_move(&page->lru, &lrugen->lists[page_gen][type]);
+			continue;
+		}
+
+		switch (__isolate_lru_page(page, ISOLATE_BOTH, type)) {
+		case 0:
+			list_move(&page->lru, dst);
+			mem_cgroup_del_lru(page);
+			nr_taken += hpage_nr_pages(page);
+			break;
+
+		case -EBUSY:
+			/* else it is being freed elsewhere */
+			list_move(&page->lru, src);
+			mem_cgroup_rotate_lru_list(page, page_lru(page));
+			break;
+
+		default:
+			BUG();
+		}
+	}
+
+	*scanned = scan;
+	return nr_taken;
+}
+
+/*
+ * Evicts up to @nr_to_scan pages from the oldest generation of a zone.
+ * Returns the number of pages reclaimed.
+ */
+static unsigned long lru_gen_evict(struct zone *zone, struct scan_control *sc,
+				   int priority, unsigned long nr_to_scan,
+				   bool can_swap)
+{
+	LIST_HEAD(page_list);
+	unsigned long nr_scanned;
+	unsigned long nr_reclaimed;
+	unsigned long nr_taken;
+	unsigned long nr_anon;
+	unsigned long nr_file;
+	int type;
+
+	lru_add_drain();
+	spin_lock_irq(&zone->lru_lock);
+	if (!zone->lrugen.enabled) {
+		spin_unlock_irq(&zone->lru_lock);
+		return 0;
+	}
+
+	try_to_inc_min_seq(zone, 0);
+	try_to_inc_min_seq(zone, 1);
+	type = lru_gen_pick_type(zone, sc, can_swap);
+	if (type < 0) {
+		spin_unlock_irq(&zone->lru_lock);
+		lru_gen_age_node(zone->zone_pgdat);
+		return 0;
+	}
+	spin_unlock_irq(&zone->lru_lock);
+
+	while (unlikely(too_many_isolated(zone, type, sc))) {
+		congestion_wait(BLK_RW_ASYNC, HZ/10);
+
+		/* We are about to die and free our memory. Return now. */
+		if (fatal_signal_pending(current))
+			return SWAP_CLUSTER_MAX;
+	}
+
+	reset_reclaim_mode(sc);
+	spin_lock_irq(&zone->lru_lock);
+	nr_taken = lru_gen_isolate_pages(zone, type, nr_to_scan,
+					 &page_list, &nr_scanned);
+	zone->pages_scanned += nr_scanned;
+	if (current_is_kswapd())
+		__count_zone_vm_events(PGSCAN_KSWAPD, zone, nr_scanned);
+	else
+		__count_zone_vm_events(PGSCAN_DIRECT, zone, nr_scanned);
+
+	if (nr_taken == 0) {
+		spin_unlock_irq(&zone->lru_lock);
+		return 0;
+	}
+
+	update_isolated_counts(zone, sc, &nr_anon, &nr_file, &page_list);
+
+	spin_unlock_irq(&zone->lru_lock);
+
+	nr_reclaimed = shrink_page_list(&page_list, zone, sc);
+
+	local_irq_disable();
+	if (current_is_kswapd())
+		__count_vm_events(KSWAPD_STEAL, nr_reclaimed);
+	__count_zone_vm_events(PGSTEAL, zone, nr_reclaimed);
+
+	putback_lru_pages(zone, sc, nr_anon, nr_file, &page_list);
+
+	return nr_reclaimed;
+}
+
+static void lru_gen_shrink_zone(int priority, struct zone *zone,
+				struct scan_control *sc)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	bool can_swap = sc->may_swap && get_nr_swap_pages() > 0;
+	unsigned long nr_reclaimed = 0;
+	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
+	unsigned long nr_to_scan;
+	long size = 0;
+	int gen;
+
+	for (gen = 0; gen < MAX_NR_GENS; gen++) {
+		if (can_swap)
+			size += max(lrugen->nr_pages[gen][0], 0L);
+		size += max(lrugen->nr_pages[gen][1], 0L);
+	}
+
+	nr_to_scan = size >> priority;
+	if (!nr_to_scan && size)
+		nr_to_scan = min_t(unsigned long, size, SWAP_CLUSTER_MAX);
+
+	while (nr_to_scan) {
+		unsigned long nr = min_t(unsigned long, nr_to_scan,
+					 SWAP_CLUSTER_MAX);
+
+		nr_reclaimed += lru_gen_evict(zone, sc, priority, nr, can_swap);
+		nr_to_scan -= nr;
+
+		if (!lru_gen_enabled())
+			break;
+		if (nr_reclaimed >= nr_to_reclaim && priority < DEF_PRIORITY)
+			break;
+	}
+	sc->nr_reclaimed += nr_reclaimed;
+
+	throttle_vm_writeout(sc->gfp_mask);
+}
+
+/* Move the evictable pages of @zone onto the generation lists */
+static void lru_gen_fill_zone(struct zone *zone)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	unsigned long nr_moved = 0;
+	enum lru_list l;
+	int gen, type;
+
+	spin_lock_irq(&zone->lru_lock);
+	for (gen = 0; gen < MAX_NR_GENS; gen++)
+		for (type = 0; type < 2; type++)
+			lrugen->nr_pages[gen][type] = 0;
+	lrugen->timestamps[lru_gen_from_seq(lrugen->max_seq)] = jiffies;
+	lrugen->enabled = true;
+
+	for_each_evictable_lru(l) {
+		struct list_head *head = &zone->lru[l].list;
+
+		/* From the oldest to the youngest page */
+		while (!list_empty(head)) {
+			struct page *page = lru_to_page(head);
+
+			list_move(&page->lru, lru_gen_page_list(zone, page));
+
+			if (!(++nr_moved % LRU_GEN_BATCH)) {
+				spin_unlock_irq(&zone->lru_lock);
+				cond_resched();
+				spin_lock_irq(&zone->lru_lock);
+			}
+		}
+	}
+	spin_unlock_irq(&zone->lru_lock);
+}
+
+/* Move the pages on the generation lists of @zone back to the LRU lists */
+static void lru_gen_drain_zone(struct zone *zone)
+{
+	struct lru_gen_struct *lrugen = &zone->lrugen;
+	unsigned long nr_moved = 0;
+	unsigned long seq;
+	int type;
+
+	spin_lock_irq(&zone->lru_lock);
+	lrugen->enabled = false;
+
+	/* From the oldest to the youngest page */
+	for (type = 0; type < 2; type++) {
+		for (seq = lrugen->min_seq[type]; seq <= lrugen->max_seq; seq++) {
+			int gen = lru_gen_from_seq(seq);
+			struct list_head *head = &lrugen->lists[gen][type];
+
+			while (!list_empty(head)) {
+				struct page *page = lru_to_page(head);
+
+				lru_gen_del_page(zone, page);
+				list_move(&page->lru,
+					  &zone->lru[page_lru(page)].list);
+
+				if (!(++nr_moved % LRU_GEN_BATCH)) {
+					spin_unlock_irq(&zone->lru_lock);
+					cond_resched();
+					spin_lock_irq(&zone->lru_lock);
+				}
+			}
+		}
+		lrugen->min_seq[type] = lrugen->max_seq;
+	}
+	spin_unlock_irq(&zone->lru_lock);
+}
+
+static void lru_gen_change_state(bool enable)
+{
+	struct zone *zone;
+
+	mutex_lock(&lru_gen_state_mutex);
+	if (enable == lru_gen_enabled_flag)
+		goto unlock;
+
+	/*
+	 * Reclaim keeps scanning the LRU lists until every zone has moved
+	 * its pages over, and stops using the generations before any zone
+	 * moves them back.
+	 */
+	if (!enable)
+		lru_gen_enabled_flag = false;
+
+	lru_add_drain_all();
+	for_each_populated_zone(zone) {
+		if (enable)
+			lru_gen_fill_zone(zone);
+		else
+			lru_gen_drain_zone(zone);
+	}
+
+	if (enable)
+		lru_gen_enabled_flag = true;
+unlock:
+	mutex_unlock(&lru_gen_state_mutex);
+}
+
+/*
+ * Zones are only switched over by lru_gen_change_state() and when memory
+ * is onlined: reclaim keeps using the LRU lists for any other zone.
+ */
+static bool lru_gen_zone_enabled(struct zone *zone)
+{
+	return lru_gen_enabled() && zone->lrugen.enabled;
+}
+
+#ifdef CONFIG_MEMORY_HOTPLUG
+/*
+ * A zone which gets populated after the generations were turned on had
+ * nothing to move over then: switch it over as its memory comes online.
+ */
+static int lru_gen_memory_callback(struct notifier_block *self,
+				   unsigned long action, void *arg)
+{
+	struct memory_notify *mn = arg;
+	struct zone *zone;
+
+	if (action != MEM_ONLINE)
+		return NOTIFY_OK;
+
+	zone = page_zone(pfn_to_page(mn->start_pfn));
+
+	mutex_lock(&lru_gen_state_mutex);
+	if (lru_gen_enabled_flag && !zone->lrugen.enabled)
+		lru_gen_fill_zone(zone);
+	mutex_unlock(&lru_gen_state_mutex);
+
+	return NOTIFY_OK;
+}
+#endif
+
+static int __init setup_lru_gen(char *str)
+{
+	return strtobool(str, &lru_gen_boot_state) == 0;
+}
+__setup("lru_gen=", setup_lru_gen);
+
+#ifdef CONFIG_SYSFS
+static ssize_t lru_gen_enabled_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", lru_gen_enabled());
+}
+
+static ssize_t lru_gen_enabled_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t count)
+{
+	bool enable;
+
+	if (strtobool(buf, &enable))
+		return -EINVAL;
+
+	lru_gen_change_state(enable);
+	return count;
+}
+
+static struct kobj_attribute lru_gen_enabled_attr =
+	__ATTR(enabled, 0644, lru_gen_enabled_show, lru_gen_enabled_store);
+
+static struct attribute *lru_gen_attrs[] = {
+	&lru_gen_enabled_attr.attr,
+	NULL,
+};
+
+static struct attribute_group lru_gen_attr_group = {
+	.attrs = lru_gen_attrs,
+	.name = "lru_gen",
+};
+#endif /* CONFIG_SYSFS */
+
+#ifdef CONFIG_DEBUG_FS
+/*
+ * /sys/kernel/debug/lru_gen: for each zone, the generations from the
+ * youngest to the oldest, with their age and their anon and file sizes.
+ */
+static int lru_gen_seq_show(struct seq_file *m, void *v)
+{
+	struct zone *zone;
+
+	for_each_populated_zone(zone) {
+		struct lru_gen_struct *lrugen = &zone->lrugen;
+		unsigned long seq, min_seq;
+
+		seq_printf(m, "node %d zone %s%s\n", zone_to_nid(zone),
+			   zone->name, lrugen->enabled ? "" : " (disabled)");
+
+		spin_lock_irq(&zone->lru_lock);
+		min_seq = min(lrugen->min_seq[0], lrugen->min_seq[1]);
+		for (seq = lrugen->max_seq + 1; seq-- > min_seq; ) {
+			int gen = lru_gen_from_seq(seq);
+			long anon = seq < lrugen->min_seq[0] ? 0 :
+				    max(lrugen->nr_pages[gen][0], 0L);
+			long file = seq < lrugen->min_seq[1] ? 0 :
+				    max(lrugen->nr_pages[gen][1], 0L);
+
+			seq_printf(m, " %10lu %10u %12ld %12ld\n", seq,
+				   jiffies_to_msecs(jiffies -
+						    lrugen->timestamps[gen]),
+				   anon, file);
+		}
+		spin_unlock_irq(&zone->lru_lock);
+	}
+	return 0;
+}
+
+static int lru_gen_seq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lru_gen_seq_show, NULL);
+}
+
+static const struct file_operations lru_gen_fops = {
+	.open		= lru_gen_seq_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif /* CONFIG_DEBUG_FS */
+
+static int __init init_lru_gen(void)
+{
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &lru_gen_attr_group))
+		printk(KERN_ERR "lru_gen: failed to create sysfs group\n");
+#endif
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("lru_gen", 0444, NULL, NULL, &lru_gen_fops);
+#endif
+	lru_gen_change_state(lru_gen_boot_state);
+#ifdef CONFIG_MEMORY_HOTPLUG
+	hotplug_memory_notifier(lru_gen_memory_callback, 0);
+#endif
+	return 0;
+}
+late_initcall(init_lru_gen);
+
+#else /* !CONFIG_LRU_GEN */
+
+static inline bool lru_gen_zone_enabled(struct zone *zone)
+{
+	return false;
+}
+
+static inline void lru_gen_shrink_zone(int priority, struct zone *zone,
+				       struct scan_control *sc)
+{
+}
+
+#endif /* CONFIG_LRU_GEN */
+
 /*
  * This is a basic per-zone page freer.  Used by both kswapd and direct reclaim.
  */
@@ -1934,6 +2770,12 @@ static void shrink_zone(int priority, struct zone *zone,
 	unsigned long nr_reclaimed, nr_scanned;
 	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
 
+	/* The generations only cover global reclaim, memcgs use their lists */
+	if (lru_gen_zone_enabled(zone) && scanning_global_lru(sc)) {
+		lru_gen_shrink_zone(priority, zone, sc);
+		return;
+	}
+
 restart:
 	nr_reclaimed = 0;
 	nr_scanned = sc->nr_scanned;
@@ -2148,6 +2990,12 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 	}
 
 out:
+	if (scanning_global_lru(sc)) {
+		for_each_zone_zonelist(zone, z, zonelist,
+				gfp_zone(sc->gfp_mask))
+			snapshot_refaults(zone);
+	}
+
 	delayacct_freepages_end();
 	put_mems_allowed();
 
@@ -2579,6 +3427,8 @@ loop_again:
 			break;
 	}
 out:
+	for (i = 0; i < pgdat->nr_zones; i++)
+		snapshot_refaults(pgdat->node_zones + i);
 
 	/*
 	 * order-0: All zones must meet high watermark for a balanced node
@@ -2674,6 +3524,14 @@ static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx)
 	if (!sleeping_prematurely(pgdat, order, remaining, classzone_idx)) {
 		trace_mm_vmscan_kswapd_sleep(pgdat->node_id);
 
+		/*
+		 * kswapd has freed enough order-0 pages, but a high-order
+		 * request may still be failing because of fragmentation.
+		 * Hand that over to kcompactd before going to sleep, so
+		 * that the allocator does not have to compact directly.
+		 */
+		wakeup_kcompactd(pgdat, order, classzone_idx);
+
 		/*
 		 * vmstat counters are not perfectly accurate and the estimated
 		 * value for counters such as NR_FREE_PAGES can deviate from the
@@ -2822,7 +3680,7 @@ unsigned long global_reclaimable_pages(void)
 	nr = global_page_state(NR_ACTIVE_FILE) +
 	     global_page_state(NR_INACTIVE_FILE);
 
-	if (nr_swap_pages > 0)
+	if (get_nr_swap_pages() > 0)
 		nr += global_page_state(NR_ACTIVE_ANON) +
 		      global_page_state(NR_INACTIVE_ANON);
 
@@ -2836,7 +3694,7 @@ unsigned long zone_reclaimable_pages(struct zone *zone)
 	nr = zone_page_state(zone, NR_ACTIVE_FILE) +
 	     zone_page_state(zone, NR_INACTIVE_FILE);
 
-	if (nr_swap_pages > 0)
+	if (get_nr_swap_pages() > 0)
 		nr += zone_page_state(zone, NR_ACTIVE_ANON) +
 		      zone_page_state(zone, NR_INACTIVE_ANON);
 
@@ -3219,7 +4077,7 @@ retry:
 		enum lru_list l = page_lru_base_type(page);
 
 		__dec_zone_state(zone, NR_UNEVICTABLE);
-		list_move(&page->lru, &zone->lru[l].list);
+		list_move(&page->lru, lru_list_head(zone, page, l));
 		mem_cgroup_move_lists(page, LRU_UNEVICTABLE, l);
 		__inc_zone_state(zone, NR_INACTIVE_ANON + l);
 		__count_vm_event(UNEVICTABLE_PGRESCUED);
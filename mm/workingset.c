@@ -0,0 +1,447 @@
+/*
+ * linux/mm/workingset.c
+ *
+ * Workingset detection based on the refault distance of page cache
+ */
+
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/swap.h>
+#include <linux/vmstat.h>
+#include <linux/pagemap.h>
+#include <linux/pagevec.h>
+#include <linux/radix-tree.h>
+#include <linux/spinlock.h>
+
+/*
+ *		Double CLOCK lists
+ *
+ * Per zone, two clock lists are maintained for file pages: the
+ * inactive and the active list.  Freshly faulted pages start out at
+ * the head of the inactive list and page reclaim scans pages from the
+ * tail.  Pages that are accessed multiple times on the inactive list
+ * are promoted to the active list, to protect them from reclaim,
+ * whereas active pages are demoted to the inactive list when the
+ * active list grows too big.
+ *
+ *   fault ------------------------+
+ *                                 |
+ *              +--------------+   |            +-------------+
+ *   reclaim <- |   inactive   | <-+-- demotion |    active   | <--+
+ *              +--------------+                +-------------+    |
+ *                     |                                           |
+ *                     +-------------- promotion ------------------+
+ *
+ *
+ *		Access frequency and refault distance
+ *
+ * A workload is thrashing when its pages are frequently used but they
+ * are evicted from the inactive list every time before another access
+ * would have promoted them to the active list.
+ *
+ * In cases where the average access distance between thrashing pages
+ * is bigger than the size of memory there is nothing that can be
+ * done - the thrashing set could never fit into memory under any
+ * circumstance.
+ *
+ * However, the average access distance could be bigger than the
+ * inactive list, yet smaller than the size of memory.  In this case,
+ * the set could fit into memory if it weren't for the currently
+ * active pages - which may be used more, hopefully less frequently:
+ *
+ *      +-memory available to cache-+
+ *      |                           |
+ *      +-inactive------+-active----+
+ *  a b | c d e f g h i | J K L M N |
+ *      +---------------+-----------+
+ *
+ * It is prohibitively expensive to accurately track access frequency
+ * of pages.  But a reasonable approximation can be made to measure
+ * thrashing on the inactive list, after which refaulting pages can be
+ * activated optimistically to compete with the existing active pages.
+ *
+ * Approximating inactive page access frequency - Observations:
+ *
+ * 1. When a page is accessed for the first time, it is added to the
+ *    head of the inactive list, slides every existing inactive page
+ *    towards the tail by one slot, and pushes the current tail page
+ *    out of memory.
+ *
+ * 2. When a page is accessed for the second time, it is promoted to
+ *    the active list, shrinking the inactive list by one slot.  This
+ *    also slides all inactive pages that were faulted into the cache
+ *    more recently than the activated page towards the tail of the
+ *    inactive list.
+ *
+ * Thus:
+ *
+ * 1. The sum of evictions and activations between any two points in
+ *    time indicate the minimum number of inactive pages accessed in
+ *    between.
+ *
+ * 2. Moving one inactive page N page slots towards the tail of the
+ *    list requires at least N inactive page accesses.
+ *
+ * Combining these:
+ *
+ * 1. When a page is finally evicted from memory, the number of
+ *    inactive pages accessed while the page was in cache is at least
+ *    the number of page slots on the inactive list.
+ *
+ * 2. In addition, measuring the sum of evictions and activations (E)
+ *    at the time of a page's eviction, and comparing it to another
+ *    reading (R) at the time the page faults back into memory tells
+ *    the minimum number of accesses while the page was not cached.
+ *    This is called the refault distance.
+ *
+ * Because the first access of the page was the fault and the second
+ * access the refault, we combine the in-cache distance with the
+ * out-of-cache distance to get the complete minimum access distance
+ * of this page:
+ *
+ *      NR_inactive + (R - E)
+ *
+ * And knowing the minimum access distance of a page, we can easily
+ * tell if the page would be able to stay in cache assuming all page
+ * slots in the cache were available:
+ *
+ *   NR_inactive + (R - E) <= NR_inactive + NR_active
+ *
+ * which can be further simplified to
+ *
+ *   (R - E) <= NR_active
+ *
+ * Put into words, the refault distance (out-of-cache) can be seen as
+ * a deficit in inactive list space (in-cache).  If the inactive list
+ * had (R - E) more page slots, the page would not have been evicted
+ * in between accesses, but activated instead.  And on a full system,
+ * the only thing eating into inactive list space is active pages.
+ *
+ *
+ *		Activating refaulting pages
+ *
+ * All that is known about the active list is that the pages have
+ * been accessed more than once in the past.  This means that at any
+ * given time there is actually a good chance that pages on the active
+ * list are no longer in active use.
+ *
+ * So when a refault distance of (R - E) is observed and there are at
+ * least (R - E) active pages, the refaulting page is activated
+ * optimistically in the hope that (R - E) active pages are actually
+ * used less frequently than the refaulting page - or even not used at
+ * all anymore.
+ *
+ * If this is wrong and demotion kicks in, the pages which are truly
+ * used more frequently will be reactivated while the less frequently
+ * used once will be evicted from memory.
+ *
+ * But if this is right, the stale pages will be pushed out of memory
+ * and the used pages get to stay in cache.  To speed this up, page
+ * reclaim keeps the active file list aging for as long as refaulting
+ * pages keep getting activated, see inactive_file_is_low_global().
+ *
+ *
+ *		Implementation
+ *
+ * For each zone's file LRU lists, a counter for inactive evictions
+ * and activations is maintained (zone->inactive_age).
+ *
+ * On eviction, a snapshot of this counter (along with some bits to
+ * identify the zone) is stored at the index of the evicted page.  This
+ * is called a shadow entry.  The shadow entries are kept in a radix
+ * tree of their own, mapping->shadow_tree, next to the page cache, so
+ * that none of the page cache lookups have to learn about them.
+ *
+ * On cache misses for which there are shadow entries, an eligible
+ * refault distance will immediately activate the refaulting page.
+ *
+ * Shadow entries are removed again when the page refaults, when the
+ * range is truncated, and when the inode is evicted.  Those that
+ * outlive their usefulness are reclaimed by a shrinker.
+ */
+
+#define SHADOW_ENTRY		2UL	/* never looks like a radix node */
+#define SHADOW_ENTRY_SHIFT	2
+#define EVICTION_SHIFT		(SHADOW_ENTRY_SHIFT + NODES_SHIFT + ZONES_SHIFT)
+#define EVICTION_MASK		(~0UL >> EVICTION_SHIFT)
+
+/*
+ * Mappings that have shadow entries, so that the shrinker can find
+ * them.  Nests inside mapping->tree_lock.
+ */
+static DEFINE_SPINLOCK(shadow_lock);
+static LIST_HEAD(shadow_mappings);
+static atomic_long_t nr_shadows = ATOMIC_LONG_INIT(0);
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << SHADOW_ENTRY_SHIFT) | SHADOW_ENTRY;
+
+	return (void *)eviction;
+}
+
+static void unpack_shadow(void *shadow,
+			  struct zone **zone,
+			  unsigned long *distance)
+{
+	unsigned long entry = (unsigned long)shadow;
+	unsigned long eviction;
+	unsigned long refault;
+	int zid, nid;
+
+	entry >>= SHADOW_ENTRY_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+	eviction = entry;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+
+	refault = atomic_long_read(&(*zone)->inactive_age);
+
+	/*
+	 * The unsigned subtraction here gives an accurate distance
+	 * across inactive_age overflows in most cases.
+	 *
+	 * There is a special case: usually, shadow entries have a short
+	 * lifetime and are either refaulted or reclaimed along with the
+	 * inode before they get too old.  But it is not impossible for
+	 * the inactive_age to lap a shadow entry in the field, which can
+	 * then result in a false small refault distance, leading to a
+	 * false activation should this old entry actually refault again.
+	 * The active list is aged regardless, so the occasional
+	 * inappropriate activation is not a problem.
+	 */
+	*distance = (refault - eviction) & EVICTION_MASK;
+}
+
+/*
+ * Only mappings embedded in an inode are torn down through
+ * end_writeback(), which gets rid of their shadow entries.
+ */
+static inline bool mapping_can_shadow(struct address_space *mapping)
+{
+	return mapping->host && &mapping->host->i_data == mapping;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from memory
+ * @mapping: address space the page was backing
+ * @page: the page being evicted
+ *
+ * Leaves a shadow entry for @page at its index in @mapping.  The
+ * caller must hold @mapping->tree_lock and have removed the page from
+ * the page cache already.
+ */
+void workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+	void **slot;
+	void *shadow;
+
+	if (!mapping_can_shadow(mapping))
+		return;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	shadow = pack_shadow(eviction, zone);
+
+	slot = radix_tree_lookup_slot(&mapping->shadow_tree, page->index);
+	if (slot) {
+		radix_tree_replace_slot(slot, shadow);
+		return;
+	}
+	/* The shadow tree is never preloaded, failure is not fatal */
+	if (radix_tree_insert(&mapping->shadow_tree, page->index, shadow))
+		return;
+
+	atomic_long_inc(&nr_shadows);
+	if (!mapping->nrshadows++) {
+		spin_lock(&shadow_lock);
+		list_add_tail(&mapping->shadow_list, &shadow_mappings);
+		spin_unlock(&shadow_lock);
+	}
+}
+
+/**
+ * workingset_take_shadow - remove a shadow entry from a mapping
+ * @mapping: address space the page is being added to
+ * @index: page cache index of the page
+ *
+ * Returns the shadow entry left at @index by a previous eviction, or
+ * %NULL.  The caller must hold @mapping->tree_lock.
+ */
+void *workingset_take_shadow(struct address_space *mapping, pgoff_t index)
+{
+	void *shadow;
+
+	if (!mapping->nrshadows)
+		return NULL;
+
+	shadow = radix_tree_delete(&mapping->shadow_tree, index);
+	if (shadow) {
+		atomic_long_dec(&nr_shadows);
+		if (!--mapping->nrshadows) {
+			spin_lock(&shadow_lock);
+			list_del_init(&mapping->shadow_list);
+			spin_unlock(&shadow_lock);
+		}
+	}
+	return shadow;
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: shadow entry of the evicted page
+ *
+ * Calculates and evaluates the refault distance of the previously
+ * evicted page in the context of the zone it was allocated in.
+ *
+ * Returns %true if the page should be activated, %false otherwise.
+ */
+bool workingset_refault(void *shadow)
+{
+	unsigned long refault_distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &refault_distance);
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+/*
+ * Remove up to @nr_to_scan shadow entries between @start and @end
+ * from @mapping, whose tree_lock must be held.  The caller takes care
+ * of the shadow_mappings list.  Returns the number of entries removed
+ * and updates *@start to where the next scan should continue.
+ */
+static unsigned long __workingset_forget(struct address_space *mapping,
+					 pgoff_t *start, pgoff_t end,
+					 unsigned long nr_to_scan)
+{
+	unsigned long indices[PAGEVEC_SIZE];
+	void **slots[PAGEVEC_SIZE];
+	unsigned long removed = 0;
+	unsigned int nr, i;
+
+	while (mapping->nrshadows && removed < nr_to_scan) {
+		nr = radix_tree_gang_lookup_slot(&mapping->shadow_tree, slots,
+				indices, *start,
+				min_t(unsigned long, PAGEVEC_SIZE,
+				      nr_to_scan - removed));
+		if (!nr)
+			break;
+		for (i = 0; i < nr; i++) {
+			if (indices[i] > end)
+				goto out;
+			radix_tree_delete(&mapping->shadow_tree, indices[i]);
+			mapping->nrshadows--;
+			removed++;
+		}
+		*start = indices[nr - 1] + 1;
+		if (!*start)
+			break;
+	}
+out:
+	atomic_long_sub(removed, &nr_shadows);
+	return removed;
+}
+
+/**
+ * workingset_forget - drop the shadow entries in a range of a mapping
+ * @mapping: address space to operate on
+ * @start: first page index
+ * @end: last page index, inclusive
+ *
+ * Called when a range of @mapping is truncated and when the inode is
+ * evicted.  May sleep.
+ */
+void workingset_forget(struct address_space *mapping,
+		       pgoff_t start, pgoff_t end)
+{
+	unsigned long removed;
+
+	if (!mapping->nrshadows)
+		return;
+
+	do {
+		cond_resched();
+		spin_lock_irq(&mapping->tree_lock);
+		removed = __workingset_forget(mapping, &start, end,
+					      PAGEVEC_SIZE);
+		if (!mapping->nrshadows) {
+			spin_lock(&shadow_lock);
+			list_del_init(&mapping->shadow_list);
+			spin_unlock(&shadow_lock);
+		}
+		spin_unlock_irq(&mapping->tree_lock);
+	} while (removed == PAGEVEC_SIZE && start);
+}
+
+/*
+ * Shadow entries take up memory of their own.  Once the inactive age
+ * has moved on by more than the size of the active list, they are
+ * useless, so let them go with the other caches under pressure,
+ * oldest mapping first.
+ */
+static int shrink_shadows(struct shrinker *shrink, struct shrink_control *sc)
+{
+	unsigned long nr_to_scan = sc->nr_to_scan;
+
+	if (nr_to_scan) {
+		struct address_space *mapping, *next;
+
+		spin_lock_irq(&shadow_lock);
+		list_for_each_entry_safe(mapping, next, &shadow_mappings,
+					 shadow_list) {
+			pgoff_t start = 0;
+
+			/* shadow_lock nests inside tree_lock */
+			if (!spin_trylock(&mapping->tree_lock))
+				continue;
+			nr_to_scan -= __workingset_forget(mapping, &start,
+							  ULONG_MAX,
+							  nr_to_scan);
+			if (!mapping->nrshadows)
+				list_del_init(&mapping->shadow_list);
+			else
+				list_move_tail(&mapping->shadow_list,
+					       &shadow_mappings);
+			spin_unlock(&mapping->tree_lock);
+			if (!nr_to_scan)
+				break;
+		}
+		spin_unlock_irq(&shadow_lock);
+	}
+	return (atomic_long_read(&nr_shadows) / 100) * sysctl_vfs_cache_pressure;
+}
+
+static struct shrinker shadow_shrinker = {
+	.shrink = shrink_shadows,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static int __init workingset_init(void)
+{
+	register_shrinker(&shadow_shrinker);
+	return 0;
+}
+module_init(workingset_init);
@@ -74,6 +74,22 @@
 static struct kmem_cache *skbuff_head_cache __read_mostly;
 static struct kmem_cache *skbuff_fclone_cache __read_mostly;
 
+/*
+ * sk_buff heads freed in NAPI context are kept in a per-cpu cache, from
+ * which napi_alloc_skb() takes them back. The cache is refilled from, and
+ * drained to, skbuff_head_cache in bulk.
+ */
+#define NAPI_SKB_CACHE_SIZE	64
+#define NAPI_SKB_CACHE_BULK	16
+#define NAPI_SKB_CACHE_HALF	(NAPI_SKB_CACHE_SIZE / 2)
+
+struct napi_skb_cache {
+	unsigned int skb_count;
+	void *skb_cache[NAPI_SKB_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct napi_skb_cache, napi_skb_cache);
+
 static void sock_pipe_buf_release(struct pipe_inode_info *pipe,
 				  struct pipe_buffer *buf)
 {
@@ -153,6 +169,37 @@ static void skb_under_panic(struct sk_buff *skb, int sz, void *here)
  *
  */
 
+/*
+ * Set up a new head to use data, of size bytes plus the shared info, as
+ * its buffer.
+ */
+static void __alloc_skb_init(struct sk_buff *skb, u8 *data, unsigned int size)
+{
+	struct skb_shared_info *shinfo;
+
+	/*
+	 * Only clear those fields we need to clear, not those that we will
+	 * actually initialise below. Hence, don't put any more fields after
+	 * the tail pointer in struct sk_buff!
+	 */
+	memset(skb, 0, offsetof(struct sk_buff, tail));
+	skb->truesize = size + sizeof(struct sk_buff);
+	atomic_set(&skb->users, 1);
+	skb->head = data;
+	skb->data = data;
+	skb_reset_tail_pointer(skb);
+	skb->end = skb->tail + size;
+#ifdef NET_SKBUFF_DATA_USES_OFFSET
+	skb->mac_header = ~0U;
+#endif
+
+	/* make sure we initialize shinfo sequentially */
+	shinfo = skb_shinfo(skb);
+	memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
+	atomic_set(&shinfo->dataref, 1);
+	kmemcheck_annotate_variable(shinfo->destructor_arg);
+}
+
 /**
  *	__alloc_skb	-	allocate a network buffer
  *	@size: size to allocate
@@ -172,7 +219,6 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 			    int fclone, int node)
 {
 	struct kmem_cache *cache;
-	struct skb_shared_info *shinfo;
 	struct sk_buff *skb;
 	u8 *data;
 
@@ -191,27 +237,7 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 		goto nodata;
 	prefetchw(data + size);
 
-	/*
-	 * Only clear those fields we need to clear, not those that we will
-	 * actually initialise below. Hence, don't put any more fields after
-	 * the tail pointer in struct sk_buff!
-	 */
-	memset(skb, 0, offsetof(struct sk_buff, tail));
-	skb->truesize = size + sizeof(struct sk_buff);
-	atomic_set(&skb->users, 1);
-	skb->head = data;
-	skb->data = data;
-	skb_reset_tail_pointer(skb);
-	skb->end = skb->tail + size;
-#ifdef NET_SKBUFF_DATA_USES_OFFSET
-	skb->mac_header = ~0U;
-#endif
-
-	/* make sure we initialize shinfo sequentially */
-	shinfo = skb_shinfo(skb);
-	memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
-	atomic_set(&shinfo->dataref, 1);
-	kmemcheck_annotate_variable(shinfo->destructor_arg);
+	__alloc_skb_init(skb, data, size);
 
 	if (fclone) {
 		struct sk_buff *child = skb + 1;
@@ -260,6 +286,83 @@ struct sk_buff *__netdev_alloc_skb(struct net_device *dev,
 }
 EXPORT_SYMBOL(__netdev_alloc_skb);
 
+static struct sk_buff *napi_skb_cache_get(void)
+{
+	struct napi_skb_cache *nc = &__get_cpu_var(napi_skb_cache);
+
+	if (unlikely(!nc->skb_count))
+		nc->skb_count = kmem_cache_alloc_bulk(skbuff_head_cache,
+						      GFP_ATOMIC,
+						      NAPI_SKB_CACHE_BULK,
+						      nc->skb_cache);
+	if (unlikely(!nc->skb_count))
+		return NULL;
+
+	return nc->skb_cache[--nc->skb_count];
+}
+
+static void napi_skb_cache_put(struct sk_buff *skb)
+{
+	struct napi_skb_cache *nc = &__get_cpu_var(napi_skb_cache);
+
+	nc->skb_cache[nc->skb_count++] = skb;
+
+	if (unlikely(nc->skb_count == NAPI_SKB_CACHE_SIZE)) {
+		kmem_cache_free_bulk(skbuff_head_cache, NAPI_SKB_CACHE_HALF,
+				     nc->skb_cache + NAPI_SKB_CACHE_HALF);
+		nc->skb_count = NAPI_SKB_CACHE_HALF;
+	}
+}
+
+/**
+ *	__napi_alloc_skb - allocate an skbuff for rx in a specific NAPI instance
+ *	@napi: napi instance this buffer was allocated for
+ *	@length: length to allocate
+ *	@gfp_mask: get_free_pages mask, passed to alloc_skb
+ *
+ *	Like __netdev_alloc_skb(), with NET_IP_ALIGN added to the headroom,
+ *	but the head is taken from the per-cpu cache of heads freed in NAPI
+ *	context. It must only be called from the poll routine of @napi.
+ *
+ *	%NULL is returned if there is no free memory.
+ */
+struct sk_buff *__napi_alloc_skb(struct napi_struct *napi,
+				 unsigned int length, gfp_t gfp_mask)
+{
+	struct sk_buff *skb;
+	unsigned int size;
+	u8 *data;
+
+	/* netpoll runs the poll routine with interrupts disabled */
+	if (unlikely(irqs_disabled() || (gfp_mask & (__GFP_WAIT | GFP_DMA)))) {
+		skb = __netdev_alloc_skb(napi->dev, length + NET_IP_ALIGN,
+					 gfp_mask);
+		if (NET_IP_ALIGN && skb)
+			skb_reserve(skb, NET_IP_ALIGN);
+		return skb;
+	}
+
+	skb = napi_skb_cache_get();
+	if (unlikely(!skb))
+		return NULL;
+	prefetchw(skb);
+
+	size = SKB_DATA_ALIGN(length + NET_SKB_PAD + NET_IP_ALIGN);
+	data = kmalloc_track_caller(size + sizeof(struct skb_shared_info),
+				    gfp_mask);
+	if (unlikely(!data)) {
+		napi_skb_cache_put(skb);
+		return NULL;
+	}
+	prefetchw(data + size);
+
+	__alloc_skb_init(skb, data, size);
+	skb_reserve(skb, NET_SKB_PAD + NET_IP_ALIGN);
+	skb->dev = napi->dev;
+	return skb;
+}
+EXPORT_SYMBOL(__napi_alloc_skb);
+
 void skb_add_rx_frag(struct sk_buff *skb, int i, struct page *page, int off,
 		int size)
 {
@@ -462,6 +565,65 @@ void consume_skb(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(consume_skb);
 
+/**
+ *	__kfree_skb_defer - free an sk_buff in NAPI context
+ *	@skb: buffer to free, with no users left
+ *
+ *	Like __kfree_skb(), but the head goes to the per-cpu cache of heads
+ *	for napi_alloc_skb(), instead of back to the slab cache one by one.
+ *	Must be called from softirq context, and not for fast clones.
+ */
+void __kfree_skb_defer(struct sk_buff *skb)
+{
+	skb_release_all(skb);
+	napi_skb_cache_put(skb);
+}
+
+/**
+ *	napi_consume_skb - free an skbuff from a NAPI poll routine
+ *	@skb: buffer to free
+ *	@budget: the budget the poll routine was called with
+ *
+ *	Like consume_skb(), for the TX completion of drivers, which free
+ *	many skbs in a row from their poll routine. A zero @budget tells
+ *	that we were not called from NAPI context, but from netpoll.
+ */
+void napi_consume_skb(struct sk_buff *skb, int budget)
+{
+	if (unlikely(!skb))
+		return;
+
+	if (unlikely(!budget)) {
+		dev_kfree_skb_any(skb);
+		return;
+	}
+
+	if (likely(atomic_read(&skb->users) == 1))
+		smp_rmb();
+	else if (likely(!atomic_dec_and_test(&skb->users)))
+		return;
+	trace_consume_skb(skb);
+
+	if (skb->fclone != SKB_FCLONE_UNAVAILABLE) {
+		__kfree_skb(skb);
+		return;
+	}
+	__kfree_skb_defer(skb);
+}
+EXPORT_SYMBOL(napi_consume_skb);
+
+/**
+ *	napi_skb_cache_drain - release the cached heads of a dead cpu
+ *	@cpu: the cpu which went offline
+ */
+void napi_skb_cache_drain(unsigned int cpu)
+{
+	struct napi_skb_cache *nc = &per_cpu(napi_skb_cache, cpu);
+
+	kmem_cache_free_bulk(skbuff_head_cache, nc->skb_count, nc->skb_cache);
+	nc->skb_count = 0;
+}
+
 /**
  *	skb_recycle_check - check if skb can be reused for receive
  *	@skb: buffer
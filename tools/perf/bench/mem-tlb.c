@@ -0,0 +1,167 @@
+/*
+ * mem-tlb.c
+ *
+ * tlb: Cost of refilling the TLB after munmap() of a few pages
+ *
+ * Every round maps and touches a small region, unmaps it, and then
+ * times one pass over a separate, already faulted-in working set.  If
+ * the kernel flushes the whole TLB on munmap(), that pass has to refill
+ * an entry for every page of the working set; with ranged flushing it
+ * should cost about the same as a pass over a warm TLB, which is
+ * measured as the baseline.
+ *
+ * With --thread, a second thread keeps walking the working set on
+ * another CPU, so that every munmap() also needs a shootdown IPI.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <time.h>
+
+static int		nr_unmap	= 1;
+static int		nr_working_set	= 256;
+static int		nr_loops	= 10000;
+static bool		use_thread;
+
+static const struct option options[] = {
+	OPT_INTEGER('p', "pages", &nr_unmap,
+		    "Number of pages to munmap() in each round"),
+	OPT_INTEGER('w', "working-set", &nr_working_set,
+		    "Number of pages walked after each munmap()"),
+	OPT_INTEGER('l', "loop", &nr_loops,
+		    "Specify number of rounds"),
+	OPT_BOOLEAN('t', "thread", &use_thread,
+		    "Keep a second thread running in the same mm"),
+	OPT_END()
+};
+
+static const char * const bench_mem_tlb_usage[] = {
+	"perf bench mem tlb <options>",
+	NULL
+};
+
+static long page_size;
+static volatile bool done;
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Touch one word on every page, so that each page needs a TLB entry */
+static unsigned long walk(volatile char *buf, int nr_pages)
+{
+	unsigned long sum = 0;
+	int i;
+
+	for (i = 0; i < nr_pages; i++)
+		sum += buf[i * page_size];
+	return sum;
+}
+
+static void *walker(void *arg)
+{
+	while (!done)
+		walk(arg, nr_working_set);
+	return NULL;
+}
+
+static char *map_pages(int nr_pages)
+{
+	char *buf;
+
+	buf = mmap(NULL, nr_pages * page_size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		die("mmap of %d pages failed\n", nr_pages);
+	memset(buf, 1, nr_pages * page_size);
+	return buf;
+}
+
+int bench_mem_tlb(int argc, const char **argv,
+		  const char *prefix __used)
+{
+	u64 warm = 0, cold = 0, unmap = 0, t0, t1;
+	pthread_t thread;
+	char *ws, *buf;
+	int i;
+
+	argc = parse_options(argc, argv, options, bench_mem_tlb_usage, 0);
+
+	if (nr_unmap <= 0 || nr_working_set <= 0 || nr_loops <= 0) {
+		fprintf(stderr, "Invalid pages, working set or loop count\n");
+		return 1;
+	}
+
+	page_size = sysconf(_SC_PAGESIZE);
+	ws = map_pages(nr_working_set);
+
+	if (use_thread && pthread_create(&thread, NULL, walker, ws))
+		die("pthread_create failed\n");
+
+	for (i = 0; i < nr_loops; i++) {
+		buf = map_pages(nr_unmap);
+
+		walk(ws, nr_working_set);
+		t0 = now_ns();
+		walk(ws, nr_working_set);
+		t1 = now_ns();
+		warm += t1 - t0;
+
+		t0 = now_ns();
+		munmap(buf, nr_unmap * page_size);
+		t1 = now_ns();
+		unmap += t1 - t0;
+
+		t0 = now_ns();
+		walk(ws, nr_working_set);
+		t1 = now_ns();
+		cold += t1 - t0;
+	}
+
+	if (use_thread) {
+		done = true;
+		pthread_join(thread, NULL);
+	}
+	munmap(ws, nr_working_set * page_size);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# munmap() of %d pages, then a walk over %d pages%s\n\n",
+		       nr_unmap, nr_working_set,
+		       use_thread ? " (with a second thread)" : "");
+		printf(" %14lf usecs/munmap\n",
+		       (double)unmap / nr_loops / 1000);
+		printf(" %14lf nsecs/page walk with a warm TLB\n",
+		       (double)warm / nr_loops / nr_working_set);
+		printf(" %14lf nsecs/page walk after munmap\n",
+		       (double)cold / nr_loops / nr_working_set);
+		printf(" %14lf nsecs/page TLB refill cost\n",
+		       ((double)cold - (double)warm) / nr_loops /
+		       nr_working_set);
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf %lf %lf\n",
+		       (double)unmap / nr_loops / 1000,
+		       (double)warm / nr_loops / nr_working_set,
+		       (double)cold / nr_loops / nr_working_set);
+		break;
+	default:
+		/* reaching this means there's some disaster: */
+		die("unknown format: %d\n", bench_format);
+		break;
+	}
+
+	return 0;
+}
@@ -52,6 +52,9 @@ static struct bench_suite mem_suites[] = {
 	{ "memcpy",
 	  "Simple memory copy in various ways",
 	  bench_mem_memcpy },
+	{ "tlb",
+	  "TLB refill cost after munmap() of a few pages",
+	  bench_mem_tlb },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -0,0 +1,240 @@
+/*
+ * dl-test.c -- exercise the SCHED_DEADLINE policy through sched_setattr()
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Checks, in order:
+ *  - parameter validation (runtime <= deadline <= period);
+ *  - sched_getattr() returns what sched_setattr() was given;
+ *  - admission control accepts reservations up to sched_rt_runtime_us on
+ *    every online CPU, and refuses the next one;
+ *  - a CPU hog with a 10ms/100ms reservation gets about 10% of a CPU.
+ *
+ * Must be run as root.
+ *
+ * $(CROSS_COMPILE)cc -Wall -Wextra -g -O2 -o dl-test dl-test.c
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE		6
+#endif
+
+/*
+ * The numbers this kernel uses, under private names: a host libc may
+ * define __NR_sched_setattr with a different value.
+ */
+#if defined(__x86_64__)
+#define __NR_dl_sched_setattr	313
+#define __NR_dl_sched_getattr	314
+#elif defined(__i386__)
+#define __NR_dl_sched_setattr	350
+#define __NR_dl_sched_getattr	351
+#else
+#define __NR_dl_sched_setattr	273
+#define __NR_dl_sched_getattr	274
+#endif
+
+#define NSEC_PER_MSEC		1000000ULL
+#define NSEC_PER_SEC		1000000000ULL
+
+struct sched_attr {
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+};
+
+static int failures;
+
+static int sched_setattr(pid_t pid, const struct sched_attr *attr,
+			 unsigned int flags)
+{
+	return syscall(__NR_dl_sched_setattr, pid, attr, flags);
+}
+
+static int sched_getattr(pid_t pid, struct sched_attr *attr,
+			 unsigned int size, unsigned int flags)
+{
+	return syscall(__NR_dl_sched_getattr, pid, attr, size, flags);
+}
+
+static void check(int cond, const char *what)
+{
+	printf("%s: %s\n", cond ? "PASS" : "FAIL", what);
+	if (!cond)
+		failures++;
+}
+
+static void dl_attr(struct sched_attr *attr, uint64_t runtime,
+		    uint64_t deadline, uint64_t period)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->size = sizeof(*attr);
+	attr->sched_policy = SCHED_DEADLINE;
+	attr->sched_runtime = runtime;
+	attr->sched_deadline = deadline;
+	attr->sched_period = period;
+}
+
+static uint64_t now_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void test_validation(void)
+{
+	struct sched_attr attr;
+
+	dl_attr(&attr, 20 * NSEC_PER_MSEC, 10 * NSEC_PER_MSEC,
+		100 * NSEC_PER_MSEC);
+	check(sched_setattr(0, &attr, 0) < 0 && errno == EINVAL,
+	      "runtime > deadline is rejected");
+
+	dl_attr(&attr, 10 * NSEC_PER_MSEC, 200 * NSEC_PER_MSEC,
+		100 * NSEC_PER_MSEC);
+	check(sched_setattr(0, &attr, 0) < 0 && errno == EINVAL,
+	      "deadline > period is rejected");
+
+	dl_attr(&attr, 10 * NSEC_PER_MSEC, 0, 0);
+	check(sched_setattr(0, &attr, 0) < 0 && errno == EINVAL,
+	      "zero deadline is rejected");
+}
+
+/*
+ * Give sleeping children 90ms/100ms reservations until the kernel says
+ * EBUSY. With the default 950ms/1s RT limit, the root domain holds
+ * 95% of each online CPU, so exactly ncpus * 95 / 90 of them fit.
+ */
+static void test_admission(void)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	long expected = ncpus * 95 / 90, admitted = 0, i;
+	pid_t *pids;
+	int err = 0;
+
+	pids = calloc(expected + 1, sizeof(*pids));
+	if (!pids) {
+		perror("calloc");
+		check(0, "over-subscribed reservation is refused");
+		return;
+	}
+
+	for (i = 0; i <= expected; i++) {
+		struct sched_attr attr;
+
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			perror("fork");
+			break;
+		}
+		if (!pids[i]) {
+			pause();
+			_exit(0);
+		}
+
+		dl_attr(&attr, 90 * NSEC_PER_MSEC, 100 * NSEC_PER_MSEC,
+			100 * NSEC_PER_MSEC);
+		if (sched_setattr(pids[i], &attr, 0) < 0) {
+			err = errno;
+			i++;
+			break;
+		}
+		admitted++;
+	}
+
+	while (i--) {
+		if (pids[i] > 0) {
+			kill(pids[i], SIGKILL);
+			waitpid(pids[i], NULL, 0);
+		}
+	}
+	free(pids);
+
+	printf("  %ld CPU(s), %ld of %ld reservations admitted\n",
+	       ncpus, admitted, expected);
+	check(admitted == expected,
+	      "reservations fill the root domain's bandwidth");
+	check(err == EBUSY, "over-subscribed reservation is refused");
+}
+
+static void test_reservation(void)
+{
+	struct sched_attr attr, got;
+	uint64_t wall, cpu, start_wall, start_cpu;
+	unsigned int pct;
+
+	dl_attr(&attr, 10 * NSEC_PER_MSEC, 100 * NSEC_PER_MSEC,
+		100 * NSEC_PER_MSEC);
+	if (sched_setattr(0, &attr, 0) < 0) {
+		perror("sched_setattr");
+		check(0, "10ms/100ms reservation is admitted");
+		return;
+	}
+	check(1, "10ms/100ms reservation is admitted");
+
+	memset(&got, 0, sizeof(got));
+	check(sched_getattr(0, &got, sizeof(got), 0) == 0 &&
+	      got.sched_policy == SCHED_DEADLINE &&
+	      got.sched_runtime == attr.sched_runtime &&
+	      got.sched_deadline == attr.sched_deadline &&
+	      got.sched_period == attr.sched_period,
+	      "sched_getattr reports the reservation");
+
+	start_wall = now_ns(CLOCK_MONOTONIC);
+	start_cpu = now_ns(CLOCK_THREAD_CPUTIME_ID);
+	do {
+		wall = now_ns(CLOCK_MONOTONIC) - start_wall;
+	} while (wall < 2 * NSEC_PER_SEC);
+	cpu = now_ns(CLOCK_THREAD_CPUTIME_ID) - start_cpu;
+
+	pct = cpu * 100 / wall;
+	printf("  consumed %llu.%03llus of CPU in %llu.%03llus (%u%%)\n",
+	       (unsigned long long)(cpu / NSEC_PER_SEC),
+	       (unsigned long long)(cpu % NSEC_PER_SEC / NSEC_PER_MSEC),
+	       (unsigned long long)(wall / NSEC_PER_SEC),
+	       (unsigned long long)(wall % NSEC_PER_SEC / NSEC_PER_MSEC),
+	       pct);
+	check(pct >= 8 && pct <= 12, "CPU hog is confined to its bandwidth");
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	check(sched_setattr(0, &attr, 0) == 0,
+	      "switching back to SCHED_OTHER releases the reservation");
+}
+
+int main(void)
+{
+	if (geteuid()) {
+		fprintf(stderr, "dl-test: must be run as root\n");
+		return 2;
+	}
+
+	test_validation();
+	test_admission();
+	test_reservation();
+
+	printf("%d failure(s)\n", failures);
+	return failures ? 1 : 0;
+}